@@ -1,7 +1,356 @@
 ﻿#include "UEWasmAPI.h"
+#include "UEWasmMemoryAccounting.h"
+#include "UEWasmModuleRegistry.h"
+#include "UEWasmSharedMemory.h"
+
+DECLARE_CYCLE_STAT(TEXT("Context Snapshot"), STAT_WasmContextSnapshot, STATGROUP_UEWasmTime);
+DECLARE_CYCLE_STAT(TEXT("Context Restore"), STAT_WasmContextRestore, STATGROUP_UEWasmTime);
+DECLARE_MEMORY_STAT(TEXT("Context Restore Bytes Written"), STAT_WasmContextRestoreBytes, STATGROUP_UEWasmTime);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Memory Grow Events"), STAT_WasmMemoryGrowEvents, STATGROUP_UEWasmTime);
 
 namespace UEWas
 {
+	/** Granularity Restore compares and copies memory at, a host page. */
+	static constexpr SIZE_T WasmRestoreBlockSize = 4096;
+
+	static constexpr SIZE_T WasmPageSize = 65536;
+
+	/** Grow events kept per context. */
+	static constexpr int32 MaxMemoryGrowEvents = 32;
+
+	const wasm_valtype_t* GetInternedWasmValType(wasm_valkind_t Kind)
+	{
+		// Thread safe static initialization, first use always happens after the wasmtime DLL is loaded.
+		static const wasm_valtype_t* const ValTypes[] = {
+			wasm_valtype_new_i32(),
+			wasm_valtype_new_i64(),
+			wasm_valtype_new_f32(),
+			wasm_valtype_new_f64(),
+			wasm_valtype_new_anyref(),
+			wasm_valtype_new_funcref(),
+		};
+
+		switch (Kind)
+		{
+		case WASM_I32:
+			return ValTypes[0];
+		case WASM_I64:
+			return ValTypes[1];
+		case WASM_F32:
+			return ValTypes[2];
+		case WASM_F64:
+			return ValTypes[3];
+		case WASM_ANYREF:
+			return ValTypes[4];
+		case WASM_FUNCREF:
+			return ValTypes[5];
+		default:
+			checkf(false, TEXT("Unknown wasm value kind %u."), Kind);
+			return nullptr;
+		}
+	}
+
+	TWasmExecutionContext::TWasmExecutionContext(const TWasmModuleHandle& InModule, const TWasmEngine& InEngine,
+	                                             const TArray<TWasmFunctionSignaturePtr>& HostFunctions, const FString& WorkspacePath)
+	{
+		check(InModule.IsValid());
+
+		ModuleHandle = InModule;
+		ExternMapping = InModule->MakeExternMapping();
+		HostFunctionMapping = InModule->MakeImportMapping();
+		if (CreateLinker(InEngine, HostFunctions, WorkspacePath))
+		{
+			const TWasmModule& Module = InModule->Obtain(Store);
+			if (Module.IsValid())
+			{
+				Instantiate(Module);
+			}
+			else
+			{
+				Error = TEXT("Failed to obtain shared module, it belongs to a different engine.");
+			}
+		}
+	}
+
+	TWasmExecutionContext::TWasmExecutionContext(const TWasmModuleHandle& InModule,
+	                                             const TSharedRef<TWasmSharedMemoryGroup, ESPMode::ThreadSafe>& InMemoryGroup,
+	                                             const TArray<TWasmFunctionSignaturePtr>& HostFunctions, const FString& WorkspacePath)
+	{
+		check(InModule.IsValid());
+
+		MemoryGroup = InMemoryGroup;
+		ModuleHandle = InModule;
+		ExternMapping = InModule->MakeExternMapping();
+		HostFunctionMapping = InModule->MakeImportMapping();
+
+		// The group owns the store, every context of the group borrows it.
+		Store = TWasmStore(InMemoryGroup->GetStore(), TWasmStoreCustomDeleter(true));
+		SharedMemory = InMemoryGroup->GetMemory();
+		if (!CreateLinkerInStore(HostFunctions, WorkspacePath) || !InMemoryGroup->DefineMemory(Linker, Error))
+		{
+			return;
+		}
+
+		const TWasmModule& Module = InModule->Obtain(Store);
+		if (Module.IsValid())
+		{
+			Instantiate(Module);
+		}
+		else
+		{
+			Error = TEXT("Failed to obtain shared module, it belongs to a different engine.");
+		}
+	}
+
+	TWasmExecutionContext::~TWasmExecutionContext()
+	{
+		if (bMemoryAccounted)
+		{
+			TWasmMemoryAccounting::Get().RemoveContext(this);
+		}
+	}
+
+	TWasmMemoryUsage TWasmExecutionContext::GetMemoryUsage() const
+	{
+		TWasmMemoryUsage Usage;
+		// A group's memory may also be re-exported through another handle, compare what it points at.
+		const bool bSharedMemory = Memory && SharedMemory && wasm_memory_data(Memory) == wasm_memory_data(SharedMemory);
+		Usage.MemoryBytes = Memory && !bSharedMemory ? wasm_memory_data_size(Memory) : 0;
+		Usage.StoreBytes = TWasmMemoryAccounting::GetStoreOverhead();
+		for (uint32 Index = 0; Index < GetNumExports(); Index++)
+		{
+			// Table elements are a pointer each in wasmtime.
+			if (const wasm_table_t* Table = GetExportTable(Index))
+			{
+				Usage.TableBytes += static_cast<uint64>(wasm_table_size(Table)) * sizeof(void*);
+			}
+		}
+		return Usage;
+	}
+
+	void TWasmExecutionContext::UpdateMemoryAccounting() const
+	{
+		if (bMemoryAccounted)
+		{
+			TWasmMemoryAccounting::Get().UpdateContext(this, GetMemoryUsage());
+		}
+	}
+
+	bool TWasmExecutionContext::AddToMemoryAccounting()
+	{
+		FString AccountingError;
+		bMemoryAccounted = TWasmMemoryAccounting::Get().AddContext(this, GetMemoryUsage(), AccountingError);
+		if (!bMemoryAccounted)
+		{
+			Error = AccountingError;
+		}
+		return bMemoryAccounted;
+	}
+
+	bool TWasmExecutionContext::SetMemoryPolicy(const TWasmMemoryPolicy& InPolicy)
+	{
+		MemoryPolicy = InPolicy;
+		if (!Memory)
+		{
+			return InPolicy.InitialPages == 0;
+		}
+
+		if (IsOverMemoryCap())
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Memory is already %u pages, over the cap of %u."), GetMemoryPages(), MemoryPolicy.MaximumPages);
+		}
+		return ReserveMemoryPages(MemoryPolicy.InitialPages);
+	}
+
+	bool TWasmExecutionContext::ReserveMemoryPages(uint32 NumPages)
+	{
+		if (!Memory)
+		{
+			return false;
+		}
+
+		// Pick up guest growth first so it isn't attributed to the host.
+		GetMemoryEpoch();
+		const uint32 NumCurrentPages = wasm_memory_size(Memory);
+		if (NumPages <= NumCurrentPages)
+		{
+			return true;
+		}
+		if (MemoryPolicy.MaximumPages > 0 && NumPages > MemoryPolicy.MaximumPages)
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Refusing to grow memory to %u pages, the cap is %u."), NumPages, MemoryPolicy.MaximumPages);
+			return false;
+		}
+		const uint64 ContextBudget = TWasmMemoryAccounting::GetContextBudget();
+		const uint64 GrowBytes = static_cast<uint64>(NumPages - NumCurrentPages) * WasmPageSize;
+		if (ContextBudget > 0 && GetMemoryUsage().GetTotal() + GrowBytes > ContextBudget)
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Refusing to grow memory to %u pages, it's over the per context budget of %llu bytes."), NumPages,
+			       ContextBudget);
+			return false;
+		}
+		if (bMemoryAccounted && !TWasmMemoryAccounting::Get().MakeRoom(GrowBytes))
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Refusing to grow memory to %u pages, the global budget is used up."), NumPages);
+			return false;
+		}
+		if (!wasm_memory_grow(Memory, NumPages - NumCurrentPages))
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Failed to grow memory from %u to %u pages."), NumCurrentPages, NumPages);
+			return false;
+		}
+
+		UpdateMemoryCache(true);
+		return true;
+	}
+
+	void TWasmExecutionContext::UpdateMemoryCache(bool bHostInitiated) const
+	{
+		byte_t* Data = wasm_memory_data(Memory);
+		const SIZE_T Size = wasm_memory_data_size(Memory);
+
+		// The first query only establishes the baseline.
+		if (CachedMemoryData && Size != CachedMemorySize)
+		{
+			TWasmMemoryGrowEvent Event;
+			Event.Timestamp = FPlatformTime::Seconds();
+			Event.Frame = GFrameCounter;
+			Event.OldPages = CachedMemorySize / WasmPageSize;
+			Event.NewPages = Size / WasmPageSize;
+			Event.bHostInitiated = bHostInitiated;
+
+			if (MemoryGrowEvents.Num() >= MaxMemoryGrowEvents)
+			{
+				MemoryGrowEvents.RemoveAt(0, 1, false);
+			}
+			MemoryGrowEvents.Add(Event);
+			NumMemoryGrowEvents++;
+			INC_DWORD_STAT(STAT_WasmMemoryGrowEvents);
+
+			const bool bOverCap = MemoryPolicy.MaximumPages > 0 && Event.NewPages > MemoryPolicy.MaximumPages;
+			if (bOverCap)
+			{
+				UE_LOG(LogUEWasmTime, Warning, TEXT("Memory grew from %u to %u pages in frame %llu, over the cap of %u."), Event.OldPages,
+				       Event.NewPages, Event.Frame, MemoryPolicy.MaximumPages);
+			}
+			else if (MemoryPolicy.bLogGrowth)
+			{
+				UE_LOG(LogUEWasmTime, Log, TEXT("Memory grew from %u to %u pages in frame %llu (%s)."), Event.OldPages, Event.NewPages,
+				       Event.Frame, bHostInitiated ? TEXT("host") : TEXT("guest"));
+			}
+		}
+
+		const bool bGrew = CachedMemoryData && Size != CachedMemorySize;
+		CachedMemoryData = Data;
+		CachedMemorySize = Size;
+		MemoryEpoch++;
+
+		if (bGrew)
+		{
+			UpdateMemoryAccounting();
+		}
+	}
+
+	bool TWasmExecutionContext::Snapshot()
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmContextSnapshot);
+
+		SavedState = {};
+		if (!bValid)
+		{
+			return false;
+		}
+
+		if (Memory)
+		{
+			SavedState.Memory = TArray<uint8>(reinterpret_cast<const uint8*>(wasm_memory_data(Memory)), wasm_memory_data_size(Memory));
+		}
+
+		CaptureGlobals(SavedState.Globals);
+		SavedState.bValid = true;
+		return true;
+	}
+
+	void TWasmExecutionContext::CaptureGlobals(TArray<TPair<uint32, wasm_val_t>>& OutGlobals) const
+	{
+		OutGlobals.Reset();
+		for (uint32 Index = 0; Index < GetNumExports(); Index++)
+		{
+			wasm_global_t* Global = GetExportGlobal(Index);
+			if (!Global)
+			{
+				continue;
+			}
+
+			wasm_globaltype_t* GlobalType = wasm_global_type(Global);
+			const bool bMutable = wasm_globaltype_mutability(GlobalType) == WASM_VAR;
+			const wasm_valkind_t Kind = wasm_valtype_kind(wasm_globaltype_content(GlobalType));
+			wasm_globaltype_delete(GlobalType);
+
+			// References would need their own ownership handling, guests keep their state in numeric globals.
+			if (bMutable && wasm_valkind_is_num(Kind))
+			{
+				wasm_val_t Value;
+				wasm_global_get(Global, &Value);
+				OutGlobals.Emplace(Index, Value);
+			}
+		}
+	}
+
+	void TWasmExecutionContext::RestoreGlobals(const TArray<TPair<uint32, wasm_val_t>>& Globals)
+	{
+		for (const TPair<uint32, wasm_val_t>& Global : Globals)
+		{
+			wasm_global_set(GetExportGlobal(Global.Key), &Global.Value);
+		}
+	}
+
+	bool TWasmExecutionContext::Restore()
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmContextRestore);
+
+		if (!bValid || !SavedState.bValid)
+		{
+			return false;
+		}
+
+		if (Memory)
+		{
+			uint8* Data = reinterpret_cast<uint8*>(wasm_memory_data(Memory));
+			const SIZE_T DataSize = wasm_memory_data_size(Memory);
+			const SIZE_T SavedSize = SavedState.Memory.Num();
+			if (DataSize < SavedSize)
+			{
+				Error = TEXT("Restore: memory is smaller than its snapshot.");
+				return false;
+			}
+
+			// Comparing first keeps untouched pages clean instead of dirtying every page of the instance. The comparison itself reads
+			// all of memory, nothing tells us which pages the guest wrote.
+			const uint8* Saved = SavedState.Memory.GetData();
+			SIZE_T BytesWritten = 0;
+			for (SIZE_T Offset = 0; Offset < SavedSize; Offset += WasmRestoreBlockSize)
+			{
+				const SIZE_T BlockSize = FMath::Min(WasmRestoreBlockSize, SavedSize - Offset);
+				if (FMemory::Memcmp(Data + Offset, Saved + Offset, BlockSize) != 0)
+				{
+					FMemory::Memcpy(Data + Offset, Saved + Offset, BlockSize);
+					BytesWritten += BlockSize;
+				}
+			}
+
+			if (DataSize > SavedSize)
+			{
+				FMemory::Memzero(Data + SavedSize, DataSize - SavedSize);
+				BytesWritten += DataSize - SavedSize;
+			}
+			SET_MEMORY_STAT(STAT_WasmContextRestoreBytes, BytesWritten);
+		}
+
+		RestoreGlobals(SavedState.Globals);
+		return true;
+	}
+
 	bool TWasmFunctionSignature::LinkExtern(const FString& ExternModule, const FString& ExternName, const TWasmLinker& Linker,
 	                                        const TWasmExtern& Extern)
 	{
@@ -20,11 +369,7 @@ namespace UEWas
 		}
 #endif
 
-		auto ArgumentsSignature = MakeWasmValTypeVecConst(ArgumentsSignatureArray);
-		auto ResultSignature = MakeWasmValTypeVecConst(ResultSignatureArray);
-
-		const TWasmFuncType FunctionSignature = MakeWasmFuncType(MoveTemp(ArgumentsSignature), MoveTemp(ResultSignature));
-		const TWasmFunc& FuncCallback = MakeWasmFunc(Context->Store, FunctionSignature, Callback, Context);
+		const TWasmFunc& FuncCallback = MakeWasmFunc(Context->Store, FuncType, Callback, Context);
 		wasmtime_error_t* Error = wasmtime_linker_define(Context->Linker.Get(), &ModuleName.Get()->Value, &Name.Get()->Value,
 		                                                 WasmFunctionAsExtern(FuncCallback));
 		return HandleError(TEXT("Linking"), Error, nullptr);
@@ -71,7 +416,12 @@ namespace UEWas
 		wasm_val_vec_t ArgsVec = wasm_val_vec_t{(uint32)Args.Num(), Args.GetData()};
 		
 		wasm_trap_t* Trap = nullptr;
-		if (!HandleError(FString::Printf(TEXT("Function Call (%s)"), *GetFunctionSignature()),  wasmtime_func_call(Func, &ArgsVec, &ResultsVec, &Trap), Trap, bPrintError))
+		const auto ErrorContext = [this]()
+		{
+			return FString::Printf(TEXT("Function Call (%s)"), *GetFunctionSignature());
+		};
+		wasmtime_error_t* CallError = wasmtime_func_call(Func, &ArgsVec, &ResultsVec, &Trap);
+		if (!HandleError(ErrorContext, CallError, Trap, bPrintError))
 		{
 			if(bPrintError)
 			{
@@ -82,6 +432,86 @@ namespace UEWas
 		return true;
 	}
 
+	bool TWasmFunctionSignature::Call(const TWasmExecutionContext& Context, const uint32& FuncExternIndex, TArrayView<const wasm_val_t> Args,
+	                                  TArrayView<wasm_val_t> Results, bool bPrintError) const
+	{
+		wasm_func_t* Func = Context.GetExportFunction(FuncExternIndex);
+		if (!Func)
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Function (%s): export %u isn't a function!"), *WasmNameToString(Name), FuncExternIndex);
+			return false;
+		}
+		return Call(Func, Args, Results, bPrintError);
+	}
+
+	bool TWasmFunctionSignature::Call(wasm_func_t* Func, TArrayView<const wasm_val_t> Args, TArrayView<wasm_val_t> Results, bool bPrintError) const
+	{
+		check(Func);
+		if (Args.Num() != ArgumentsSignatureArray.Num() || Results.Num() != ResultSignatureArray.Num())
+		{
+			UE_LOG(LogUEWasmTime, Error, TEXT("Function (%s): signature mismatch. Given %i arguments and %i results, need %i and %i."),
+			       *WasmNameToString(Name), Args.Num(), Results.Num(), ArgumentsSignatureArray.Num(), ResultSignatureArray.Num());
+			return false;
+		}
+
+		// wasmtime_func_call doesn't take ownership of the arguments.
+		const wasm_val_vec_t ArgsVec = wasm_val_vec_t{(size_t)Args.Num(), const_cast<wasm_val_t*>(Args.GetData())};
+		wasm_val_vec_t ResultsVec = wasm_val_vec_t{(size_t)Results.Num(), Results.GetData()};
+
+		const auto ErrorContext = [this]()
+		{
+			return FString::Printf(TEXT("Function Call (%s)"), *GetFunctionSignature());
+		};
+		wasm_trap_t* Trap = nullptr;
+		wasmtime_error_t* CallError = wasmtime_func_call(Func, &ArgsVec, &ResultsVec, &Trap);
+		return HandleError(ErrorContext, CallError, Trap, bPrintError);
+	}
+
+	int32 TWasmFunctionSignature::CallBatch(const TWasmExecutionContext& Context, const uint32& FuncExternIndex, const int32& NumItems,
+	                                        TArrayView<const wasm_val_t> Args, TArrayView<wasm_val_t> Results, TBitArray<>& OutTrapMask,
+	                                        bool bPrintError) const
+	{
+		wasm_func_t* Func = Context.GetExportFunction(FuncExternIndex);
+		if (!Func)
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Function (%s): export %u isn't a function!"), *WasmNameToString(Name), FuncExternIndex);
+			return INDEX_NONE;
+		}
+
+		const int32 NumArgs = ArgumentsSignatureArray.Num();
+		const int32 NumResults = ResultSignatureArray.Num();
+		if (NumItems < 0 || Args.Num() != NumItems * NumArgs || Results.Num() != NumItems * NumResults)
+		{
+			UE_LOG(LogUEWasmTime, Error, TEXT("Function (%s): batch of %i items needs %i arguments and %i results, given %i and %i."),
+			       *WasmNameToString(Name), NumItems, NumItems * NumArgs, NumItems * NumResults, Args.Num(), Results.Num());
+			return INDEX_NONE;
+		}
+
+		OutTrapMask.Init(false, NumItems);
+
+		int32 NumCompleted = 0;
+		for (int32 Item = 0; Item < NumItems; Item++)
+		{
+			const wasm_val_vec_t ArgsVec = wasm_val_vec_t{(size_t)NumArgs, const_cast<wasm_val_t*>(Args.GetData()) + Item * NumArgs};
+			wasm_val_vec_t ResultsVec = wasm_val_vec_t{(size_t)NumResults, Results.GetData() + Item * NumResults};
+
+			wasm_trap_t* Trap = nullptr;
+			wasmtime_error_t* CallError = wasmtime_func_call(Func, &ArgsVec, &ResultsVec, &Trap);
+			if (CallError || Trap)
+			{
+				const auto ErrorContext = [this, Item]()
+				{
+					return FString::Printf(TEXT("Function Call (%s) batch item %i"), *GetFunctionSignature(), Item);
+				};
+				HandleError(ErrorContext, CallError, Trap, bPrintError);
+				OutTrapMask[Item] = true;
+				continue;
+			}
+			NumCompleted++;
+		}
+		return NumCompleted;
+	}
+
 	bool TWasmFunctionSignature::ExistsAsExtern(const TWasmItemMapPtr& InExternMapping) const
 	{
 		return InExternMapping->Contains(*GetName());
@@ -0,0 +1,54 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmAsyncCompile.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "UEWasmModuleCache.h"
+
+namespace UEWas
+{
+	static TWasmCompileResult CompileOnWorker(wasm_engine_t* RawEngine, const TWasmByteVec& Binary, const FString& EngineConfigKey)
+	{
+		SCOPED_NAMED_EVENT(WasmCompileModule, FColor::Orange);
+
+		// The caller keeps ownership of the engine.
+		const TWasmEngine Engine = TWasmEngine(RawEngine, TWasmEngineCustomDeleter(true));
+
+		TWasmCompileResult Result;
+		Result.Module = MakeWasmModuleCached(Engine, Binary, Result.Error, EngineConfigKey);
+		return Result;
+	}
+
+	TFuture<TWasmCompileResult> MakeWasmModuleAsync(const TWasmEngine& Engine, TWasmByteVec&& Binary, const FString& EngineConfigKey)
+	{
+		check(Engine.Get());
+		check(Binary.Get());
+
+		wasm_engine_t* RawEngine = Engine.Get();
+		return Async(EAsyncExecution::ThreadPool, [RawEngine, Binary = MoveTemp(Binary), EngineConfigKey]()
+		{
+			return CompileOnWorker(RawEngine, Binary, EngineConfigKey);
+		});
+	}
+
+	TFuture<TArray<TWasmCompileResult>> MakeWasmModulesAsync(const TWasmEngine& Engine, TArray<TWasmByteVec>&& Binaries,
+	                                                         const FString& EngineConfigKey)
+	{
+		check(Engine.Get());
+
+		wasm_engine_t* RawEngine = Engine.Get();
+		return Async(EAsyncExecution::ThreadPool, [RawEngine, Binaries = MoveTemp(Binaries), EngineConfigKey]()
+		{
+			TArray<TWasmCompileResult> Results;
+			Results.SetNum(Binaries.Num());
+
+			// One module per task, wasm engines are thread safe.
+			ParallelFor(Binaries.Num(), [RawEngine, &Binaries, &Results, &EngineConfigKey](int32 Index)
+			{
+				check(Binaries[Index].Get());
+				Results[Index] = CompileOnWorker(RawEngine, Binaries[Index], EngineConfigKey);
+			});
+			return Results;
+		});
+	}
+}
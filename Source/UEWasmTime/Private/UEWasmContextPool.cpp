@@ -0,0 +1,292 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmContextPool.h"
+#include "Async/Async.h"
+#include "Misc/ScopeLock.h"
+#include "UEWasmEngineSettings.h"
+#include "UEWasmMemoryAccounting.h"
+#include "UEWasmModuleRegistry.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Context Pool Hits"), STAT_WasmContextPoolHits, STATGROUP_UEWasmTime);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Context Pool Misses"), STAT_WasmContextPoolMisses, STATGROUP_UEWasmTime);
+DECLARE_CYCLE_STAT(TEXT("Context Pool Refill"), STAT_WasmContextPoolRefill, STATGROUP_UEWasmTime);
+
+namespace UEWas
+{
+	TWasmContextPool::TWasmContextPool(const TWasmModuleHandle& InModule, const FWasmEngineProfilePtr& InEngineProfile,
+	                                   const TArray<TWasmFunctionSignaturePtr>& InHostFunctions, const FString& InWorkspacePath,
+	                                   int32 InTargetSize)
+		: Module(InModule), EngineProfile(InEngineProfile), HostFunctions(InHostFunctions), WorkspacePath(InWorkspacePath),
+		  TargetSize(FMath::Max(InTargetSize, 0)), bRestoreOnRelease(false), Hits(0), Misses(0)
+	{
+		check(Module.IsValid());
+		check(EngineProfile.IsValid());
+	}
+
+	TSharedRef<TWasmContextPool, ESPMode::ThreadSafe> TWasmContextPool::Create(const TWasmModuleHandle& InModule,
+	                                                                           const FWasmEngineProfilePtr& InEngineProfile,
+	                                                                           const TArray<TWasmFunctionSignaturePtr>& InHostFunctions,
+	                                                                           const FString& InWorkspacePath, int32 InTargetSize)
+	{
+		TSharedRef<TWasmContextPool, ESPMode::ThreadSafe> Pool = MakeShared<TWasmContextPool, ESPMode::ThreadSafe>(
+			InModule, InEngineProfile, InHostFunctions, InWorkspacePath, InTargetSize);
+		TWasmMemoryAccounting::Get().AddEvictionSource(Pool);
+		Pool->RequestRefill();
+		return Pool;
+	}
+
+	TWasmExecutionContextPtr TWasmContextPool::Acquire()
+	{
+		TWasmExecutionContextPtr Context;
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (IdleContexts.Num() > 0)
+			{
+				Context = MoveTemp(IdleContexts.Pop(false).Context);
+			}
+		}
+
+		if (Context.IsValid())
+		{
+			++Hits;
+			INC_DWORD_STAT(STAT_WasmContextPoolHits);
+		}
+		else
+		{
+			++Misses;
+			INC_DWORD_STAT(STAT_WasmContextPoolMisses);
+			Context = CreateContext();
+		}
+
+		RequestRefill();
+		return Context;
+	}
+
+	void TWasmContextPool::Release(TWasmExecutionContextPtr&& Context)
+	{
+		if (!Context.IsValid())
+		{
+			return;
+		}
+
+		if (Context->HasSnapshot())
+		{
+			{
+				FScopeLock ScopeLock(&Lock);
+				NumPending++;
+			}
+
+			TWeakPtr<TWasmContextPool, ESPMode::ThreadSafe> WeakPool = AsShared();
+			Async(EAsyncExecution::ThreadPool, [WeakPool, Context = MoveTemp(Context)]() mutable
+			{
+				if (TSharedPtr<TWasmContextPool, ESPMode::ThreadSafe> Pool = WeakPool.Pin())
+				{
+					Pool->AddRestoredContext(MoveTemp(Context));
+				}
+			});
+			return;
+		}
+
+		// Tearing a store down isn't free either, do it off the calling thread.
+		Async(EAsyncExecution::ThreadPool, [Context = MoveTemp(Context)]() mutable
+		{
+			Context.Reset();
+		});
+		RequestRefill();
+	}
+
+	void TWasmContextPool::Prewarm()
+	{
+		while (true)
+		{
+			{
+				FScopeLock ScopeLock(&Lock);
+				if (IdleContexts.Num() + NumPending >= TargetSize)
+				{
+					return;
+				}
+				NumPending++;
+			}
+
+			const double StartTime = FPlatformTime::Seconds();
+			TWasmExecutionContextPtr Context = CreateContext();
+			AddRefilledContext(MoveTemp(Context), FPlatformTime::Seconds() - StartTime);
+		}
+	}
+
+	void TWasmContextPool::SetTargetSize(int32 InTargetSize)
+	{
+		// Surplus contexts are destroyed outside the lock.
+		TArray<TWasmExecutionContextPtr> Surplus;
+		{
+			FScopeLock ScopeLock(&Lock);
+			TargetSize = FMath::Max(InTargetSize, 0);
+			while (IdleContexts.Num() > TargetSize)
+			{
+				Surplus.Add(MoveTemp(IdleContexts.Pop(false).Context));
+			}
+		}
+		RequestRefill();
+	}
+
+	void TWasmContextPool::SetMemoryPolicy(const TWasmMemoryPolicy& InMemoryPolicy)
+	{
+		// INDEX_NONE keeps wasmtime's default, a 4GiB static reservation on 64 bit hosts.
+		const int64 StaticMemoryMaximumSize = EngineProfile->Settings.StaticMemoryMaximumSize;
+		if (StaticMemoryMaximumSize >= 0 && static_cast<int64>(InMemoryPolicy.MaximumPages) * 65536 > StaticMemoryMaximumSize)
+		{
+			UE_LOG(LogUEWasmTime, Log, TEXT("Memory cap of %u pages exceeds the static memory reservation of profile %s, growth may move the memory."),
+			       InMemoryPolicy.MaximumPages, *EngineProfile->Name.ToString());
+		}
+
+		FScopeLock ScopeLock(&Lock);
+		MemoryPolicy = InMemoryPolicy;
+	}
+
+	TWasmContextPoolStats TWasmContextPool::GetStats() const
+	{
+		TWasmContextPoolStats Stats;
+		Stats.Hits = Hits;
+		Stats.Misses = Misses;
+
+		FScopeLock ScopeLock(&Lock);
+		Stats.Refills = Refills;
+		Stats.Restores = Restores;
+		Stats.LastRefillSeconds = LastRefillSeconds;
+		Stats.AverageRefillSeconds = Refills > 0 ? TotalRefillSeconds / Refills : 0.0;
+		Stats.NumIdle = IdleContexts.Num();
+		Stats.NumPending = NumPending;
+		return Stats;
+	}
+
+	bool TWasmContextPool::GetOldestIdleTime(double& OutSeconds) const
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (IdleContexts.Num() == 0)
+		{
+			return false;
+		}
+		OutSeconds = IdleContexts[0].IdleSince;
+		return true;
+	}
+
+	bool TWasmContextPool::EvictOldestIdle()
+	{
+		// Destroyed outside the lock, it removes itself from the memory accounting.
+		TWasmExecutionContextPtr Evicted;
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (IdleContexts.Num() == 0)
+			{
+				return false;
+			}
+			Evicted = MoveTemp(IdleContexts[0].Context);
+			IdleContexts.RemoveAt(0, 1, false);
+		}
+		return true;
+	}
+
+	TWasmExecutionContextPtr TWasmContextPool::CreateContext() const
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmContextPoolRefill);
+
+		TWasmExecutionContextPtr Context = MakeUnique<TWasmExecutionContext>(Module, EngineProfile->Engine, HostFunctions, WorkspacePath);
+		if (!Context->IsValid())
+		{
+			UE_LOG(LogUEWasmTime, Error, TEXT("Context pool failed to instantiate module %s: %s"), *Module->Key, *Context->Error);
+			return {};
+		}
+
+		TWasmMemoryPolicy ContextMemoryPolicy;
+		{
+			FScopeLock ScopeLock(&Lock);
+			ContextMemoryPolicy = MemoryPolicy;
+		}
+		Context->SetMemoryPolicy(ContextMemoryPolicy);
+
+		// Snapshot after pre-growing, so restores don't have to zero the reserved pages.
+		if (bRestoreOnRelease)
+		{
+			Context->Snapshot();
+		}
+		return Context;
+	}
+
+	void TWasmContextPool::RequestRefill()
+	{
+		int32 NumToCreate = 0;
+		{
+			FScopeLock ScopeLock(&Lock);
+			NumToCreate = TargetSize - IdleContexts.Num() - NumPending;
+			if (NumToCreate <= 0)
+			{
+				return;
+			}
+			NumPending += NumToCreate;
+		}
+
+		TWeakPtr<TWasmContextPool, ESPMode::ThreadSafe> WeakPool = AsShared();
+		for (int32 Index = 0; Index < NumToCreate; Index++)
+		{
+			Async(EAsyncExecution::ThreadPool, [WeakPool]()
+			{
+				if (TSharedPtr<TWasmContextPool, ESPMode::ThreadSafe> Pool = WeakPool.Pin())
+				{
+					const double StartTime = FPlatformTime::Seconds();
+					TWasmExecutionContextPtr Context = Pool->CreateContext();
+					Pool->AddRefilledContext(MoveTemp(Context), FPlatformTime::Seconds() - StartTime);
+				}
+			});
+		}
+	}
+
+	void TWasmContextPool::AddRefilledContext(TWasmExecutionContextPtr&& Context, double Seconds)
+	{
+		FScopeLock ScopeLock(&Lock);
+		NumPending--;
+		if (!Context.IsValid())
+		{
+			return;
+		}
+
+		Refills++;
+		LastRefillSeconds = Seconds;
+		TotalRefillSeconds += Seconds;
+		if (IdleContexts.Num() < TargetSize)
+		{
+			IdleContexts.Add({MoveTemp(Context), FPlatformTime::Seconds()});
+		}
+	}
+
+	void TWasmContextPool::AddRestoredContext(TWasmExecutionContextPtr&& Context)
+	{
+		if (!Context->Restore())
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Context pool failed to restore a context of module %s, replacing it: %s"), *Module->Key,
+			       *Context->Error);
+			Context.Reset();
+			{
+				FScopeLock ScopeLock(&Lock);
+				NumPending--;
+			}
+			RequestRefill();
+			return;
+		}
+
+		// Destroyed outside the lock if the pool filled up in the meantime.
+		TWasmExecutionContextPtr Surplus;
+		{
+			FScopeLock ScopeLock(&Lock);
+			NumPending--;
+			Restores++;
+			if (IdleContexts.Num() < TargetSize)
+			{
+				IdleContexts.Add({MoveTemp(Context), FPlatformTime::Seconds()});
+			}
+			else
+			{
+				Surplus = MoveTemp(Context);
+			}
+		}
+	}
+}
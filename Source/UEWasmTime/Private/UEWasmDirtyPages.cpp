@@ -0,0 +1,255 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmDirtyPages.h"
+
+DECLARE_CYCLE_STAT(TEXT("Dirty Page Capture"), STAT_WasmDirtyPageCapture, STATGROUP_UEWasmTime);
+DECLARE_CYCLE_STAT(TEXT("Dirty Page Apply"), STAT_WasmDirtyPageApply, STATGROUP_UEWasmTime);
+DECLARE_MEMORY_STAT(TEXT("Dirty Page Delta Size"), STAT_WasmDirtyPageDeltaBytes, STATGROUP_UEWasmTime);
+
+namespace UEWas
+{
+	static constexpr uint64 WasmPageSize = 65536;
+
+	TWasmDirtyPageTracker::TWasmDirtyPageTracker(TWasmExecutionContext& InContext)
+		: Context(&InContext)
+	{
+	}
+
+	bool TWasmDirtyPageTracker::Begin()
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmDirtyPageCapture);
+
+		Error.Reset();
+		Sequence = INDEX_NONE;
+		if (!Context->IsValid() || !Context->GetMemory())
+		{
+			Error = TEXT("Context has no exported memory.");
+			return false;
+		}
+
+		Context->GetMemoryEpoch();
+		Shadow = TArray64<uint8>(reinterpret_cast<const uint8*>(Context->GetCachedMemoryData()), Context->GetCachedMemorySize());
+		Context->CaptureGlobals(ShadowGlobals);
+		Baseline = FGuid::NewGuid();
+		Sequence = NextSequence++;
+		return true;
+	}
+
+	bool TWasmDirtyPageTracker::Capture(TWasmMemoryDelta& OutDelta)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmDirtyPageCapture);
+
+		OutDelta = {};
+		OutDelta.BaseMemorySize = Shadow.Num();
+		if (!SyncShadowSize())
+		{
+			return false;
+		}
+
+		const uint8* Data = reinterpret_cast<const uint8*>(Context->GetCachedMemoryData());
+		uint8* ShadowData = Shadow.GetData();
+		for (int64 Offset = 0; Offset < Shadow.Num(); Offset += PageSize)
+		{
+			if (FMemory::Memcmp(Data + Offset, ShadowData + Offset, PageSize) != 0)
+			{
+				OutDelta.Pages.Add(static_cast<uint32>(Offset / PageSize));
+				OutDelta.OldData.Append(ShadowData + Offset, PageSize);
+				OutDelta.NewData.Append(Data + Offset, PageSize);
+				FMemory::Memcpy(ShadowData + Offset, Data + Offset, PageSize);
+			}
+		}
+		SET_MEMORY_STAT(STAT_WasmDirtyPageDeltaBytes, OutDelta.NewData.Num());
+
+		OutDelta.MemorySize = Shadow.Num();
+		OutDelta.BaseGlobals = MoveTemp(ShadowGlobals);
+		Context->CaptureGlobals(ShadowGlobals);
+		OutDelta.Globals = ShadowGlobals;
+		OutDelta.Baseline = Baseline;
+		OutDelta.BaseSequence = Sequence;
+		OutDelta.Sequence = NextSequence++;
+		Sequence = OutDelta.Sequence;
+		return true;
+	}
+
+	bool TWasmDirtyPageTracker::Discard()
+	{
+		if (!SyncShadowSize())
+		{
+			return false;
+		}
+
+		uint8* Data = reinterpret_cast<uint8*>(Context->GetCachedMemoryData());
+		const uint8* ShadowData = Shadow.GetData();
+		for (int64 Offset = 0; Offset < Shadow.Num(); Offset += PageSize)
+		{
+			if (FMemory::Memcmp(Data + Offset, ShadowData + Offset, PageSize) != 0)
+			{
+				FMemory::Memcpy(Data + Offset, ShadowData + Offset, PageSize);
+			}
+		}
+		Context->RestoreGlobals(ShadowGlobals);
+		return true;
+	}
+
+	bool TWasmDirtyPageTracker::ApplyChain(TArrayView<const TWasmMemoryDelta> Deltas)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmDirtyPageApply);
+
+		if (Deltas.Num() == 0)
+		{
+			return IsTracking();
+		}
+
+		int32 Expected = Sequence;
+		for (const TWasmMemoryDelta& Delta : Deltas)
+		{
+			if (!CheckBaseline(Delta))
+			{
+				return false;
+			}
+			if (Delta.BaseSequence != Expected)
+			{
+				Error = FString::Printf(TEXT("Delta %i leads from %i, expected %i."), Delta.Sequence, Delta.BaseSequence, Expected);
+				return false;
+			}
+			Expected = Delta.Sequence;
+		}
+
+		if (!Discard())
+		{
+			return false;
+		}
+
+		// Later deltas replace the pages of earlier ones.
+		TMap<uint32, const uint8*> Pages;
+		for (const TWasmMemoryDelta& Delta : Deltas)
+		{
+			for (int32 Index = 0; Index < Delta.Pages.Num(); Index++)
+			{
+				Pages.Add(Delta.Pages[Index], Delta.NewData.GetData() + static_cast<int64>(Index) * PageSize);
+			}
+		}
+
+		const TWasmMemoryDelta& Last = Deltas.Last();
+		if (!WritePages(Pages, Last.MemorySize))
+		{
+			return false;
+		}
+		ShadowGlobals = Last.Globals;
+		Context->RestoreGlobals(ShadowGlobals);
+		Sequence = Last.Sequence;
+		return true;
+	}
+
+	bool TWasmDirtyPageTracker::RevertChain(TArrayView<const TWasmMemoryDelta> Deltas)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmDirtyPageApply);
+
+		if (Deltas.Num() == 0)
+		{
+			return IsTracking();
+		}
+
+		int32 Expected = Sequence;
+		for (int32 DeltaIndex = Deltas.Num() - 1; DeltaIndex >= 0; DeltaIndex--)
+		{
+			const TWasmMemoryDelta& Delta = Deltas[DeltaIndex];
+			if (!CheckBaseline(Delta))
+			{
+				return false;
+			}
+			if (Delta.Sequence != Expected)
+			{
+				Error = FString::Printf(TEXT("Delta %i doesn't lead to state %i."), Delta.Sequence, Expected);
+				return false;
+			}
+			Expected = Delta.BaseSequence;
+		}
+
+		if (!Discard())
+		{
+			return false;
+		}
+
+		// Walking backwards, earlier deltas replace the pages of later ones.
+		TMap<uint32, const uint8*> Pages;
+		for (int32 DeltaIndex = Deltas.Num() - 1; DeltaIndex >= 0; DeltaIndex--)
+		{
+			const TWasmMemoryDelta& Delta = Deltas[DeltaIndex];
+			for (int32 Index = 0; Index < Delta.Pages.Num(); Index++)
+			{
+				Pages.Add(Delta.Pages[Index], Delta.OldData.GetData() + static_cast<int64>(Index) * PageSize);
+			}
+		}
+
+		const TWasmMemoryDelta& First = Deltas[0];
+		if (!WritePages(Pages, First.BaseMemorySize))
+		{
+			return false;
+		}
+		ShadowGlobals = First.BaseGlobals;
+		Context->RestoreGlobals(ShadowGlobals);
+		Sequence = First.BaseSequence;
+		return true;
+	}
+
+	bool TWasmDirtyPageTracker::CheckBaseline(const TWasmMemoryDelta& Delta)
+	{
+		if (!IsTracking())
+		{
+			Error = TEXT("Tracking hasn't begun.");
+			return false;
+		}
+		if (Delta.Baseline != Baseline)
+		{
+			Error = FString::Printf(TEXT("Delta %i belongs to baseline %s, the tracker is at %s."), Delta.Sequence, *Delta.Baseline.ToString(),
+			                        *Baseline.ToString());
+			return false;
+		}
+		return true;
+	}
+
+	bool TWasmDirtyPageTracker::SyncShadowSize()
+	{
+		if (!IsTracking())
+		{
+			Error = TEXT("Tracking hasn't begun.");
+			return false;
+		}
+
+		Context->GetMemoryEpoch();
+		const int64 Size = Context->GetCachedMemorySize();
+		checkf(Size % PageSize == 0, TEXT("Wasm memory of %lld bytes isn't made of whole pages."), Size);
+		if (Size < Shadow.Num())
+		{
+			Error = TEXT("Memory is smaller than the tracked state.");
+			return false;
+		}
+		Shadow.SetNumZeroed(Size, false);
+		return true;
+	}
+
+	bool TWasmDirtyPageTracker::WritePages(const TMap<uint32, const uint8*>& Pages, uint64 MemorySize)
+	{
+		if (MemorySize > static_cast<uint64>(Shadow.Num()))
+		{
+			if (!Context->ReserveMemoryPages(MemorySize / WasmPageSize))
+			{
+				Error = FString::Printf(TEXT("Failed to grow memory to %llu bytes."), MemorySize);
+				return false;
+			}
+			SyncShadowSize();
+		}
+
+		uint8* Data = reinterpret_cast<uint8*>(Context->GetCachedMemoryData());
+		uint8* ShadowData = Shadow.GetData();
+		for (const TPair<uint32, const uint8*>& Page : Pages)
+		{
+			const int64 Offset = static_cast<int64>(Page.Key) * PageSize;
+			check(Offset + PageSize <= Shadow.Num());
+			FMemory::Memcpy(Data + Offset, Page.Value, PageSize);
+			FMemory::Memcpy(ShadowData + Offset, Page.Value, PageSize);
+		}
+		return true;
+	}
+}
@@ -0,0 +1,212 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmEngineSettings.h"
+#include "Misc/ConfigCacheIni.h"
+#include "UEWasmTime.h"
+
+namespace UEWas
+{
+	template <typename EnumType>
+	struct TWasmEnumName
+	{
+		EnumType Value;
+		const TCHAR* Name;
+	};
+
+	static const TWasmEnumName<EWasmEnginePreset> PresetNames[] = {
+		{EWasmEnginePreset::Default, TEXT("Default")},
+		{EWasmEnginePreset::MaxThroughput, TEXT("MaxThroughput")},
+		{EWasmEnginePreset::LowMemory, TEXT("LowMemory")},
+		{EWasmEnginePreset::FastStartup, TEXT("FastStartup")},
+	};
+
+	static const TWasmEnumName<wasmtime_strategy_t> StrategyNames[] = {
+		{WASMTIME_STRATEGY_AUTO, TEXT("Auto")},
+		{WASMTIME_STRATEGY_CRANELIFT, TEXT("Cranelift")},
+		{WASMTIME_STRATEGY_LIGHTBEAM, TEXT("Lightbeam")},
+	};
+
+	static const TWasmEnumName<wasmtime_opt_level_t> OptLevelNames[] = {
+		{WASMTIME_OPT_LEVEL_NONE, TEXT("None")},
+		{WASMTIME_OPT_LEVEL_SPEED, TEXT("Speed")},
+		{WASMTIME_OPT_LEVEL_SPEED_AND_SIZE, TEXT("SpeedAndSize")},
+	};
+
+	static const TWasmEnumName<wasmtime_profiling_strategy_t> ProfilerNames[] = {
+		{WASMTIME_PROFILING_STRATEGY_NONE, TEXT("None")},
+		{WASMTIME_PROFILING_STRATEGY_JITDUMP, TEXT("JitDump")},
+		{WASMTIME_PROFILING_STRATEGY_VTUNE, TEXT("VTune")},
+	};
+
+	template <typename EnumType, int32 Num>
+	static bool LexEnum(const TWasmEnumName<EnumType> (&Names)[Num], const FString& String, EnumType& OutValue)
+	{
+		for (const TWasmEnumName<EnumType>& Entry : Names)
+		{
+			if (String.Equals(Entry.Name, ESearchCase::IgnoreCase))
+			{
+				OutValue = Entry.Value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template <typename EnumType, int32 Num>
+	static void ReadEnum(const TWasmEnumName<EnumType> (&Names)[Num], const FString& Section, const TCHAR* Key, const FString& ConfigFile,
+	                     EnumType& OutValue)
+	{
+		FString String;
+		if (GConfig->GetString(*Section, Key, String, ConfigFile) && !LexEnum(Names, String, OutValue))
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("[%s] Unknown %s value %s, keeping the default."), *Section, Key, *String);
+		}
+	}
+
+	FWasmEngineSettings FWasmEngineSettings::MakePreset(EWasmEnginePreset Preset)
+	{
+		FWasmEngineSettings Settings;
+		switch (Preset)
+		{
+		case EWasmEnginePreset::MaxThroughput:
+			Settings.CraneliftOptLevel = WASMTIME_OPT_LEVEL_SPEED;
+			Settings.bWasmSimd = true;
+			Settings.bWasmBulkMemory = true;
+			// 4GiB static memories with 2GiB guards let cranelift drop explicit bounds checks for 32 bit memories.
+			Settings.StaticMemoryMaximumSize = 0x100000000ll;
+			Settings.StaticMemoryGuardSize = 0x80000000ll;
+			break;
+		case EWasmEnginePreset::LowMemory:
+			Settings.CraneliftOptLevel = WASMTIME_OPT_LEVEL_SPEED_AND_SIZE;
+			// Every memory is dynamic, only the committed pages are reserved.
+			Settings.StaticMemoryMaximumSize = 0;
+			Settings.StaticMemoryGuardSize = 0x10000;
+			Settings.DynamicMemoryGuardSize = 0;
+			break;
+		case EWasmEnginePreset::FastStartup:
+			Settings.CraneliftOptLevel = WASMTIME_OPT_LEVEL_NONE;
+			break;
+		case EWasmEnginePreset::Default:
+		default:
+			break;
+		}
+		return Settings;
+	}
+
+	FWasmEngineSettings FWasmEngineSettings::LoadFromConfig(const FName& Profile, const FString& ConfigFile)
+	{
+		FWasmEngineSettings Settings;
+		if (!GConfig)
+		{
+			return Settings;
+		}
+
+		const FString& Section = Profile.IsNone() ? FString(TEXT("WasmTime.Engine")) : FString::Printf(TEXT("WasmTime.Engine.%s"), *Profile.ToString());
+
+		EWasmEnginePreset Preset = EWasmEnginePreset::Default;
+		FString PresetString;
+		if (GConfig->GetString(*Section, TEXT("Preset"), PresetString, ConfigFile))
+		{
+			if (!LexPreset(PresetString, Preset))
+			{
+				UE_LOG(LogUEWasmTime, Warning, TEXT("[%s] Unknown preset %s."), *Section, *PresetString);
+			}
+		}
+		else if (!Profile.IsNone())
+		{
+			// Presets can be used as profile names without declaring a section for them.
+			LexPreset(Profile.ToString(), Preset);
+		}
+		Settings = MakePreset(Preset);
+
+		ReadEnum(StrategyNames, Section, TEXT("Strategy"), ConfigFile, Settings.Strategy);
+		ReadEnum(OptLevelNames, Section, TEXT("CraneliftOptLevel"), ConfigFile, Settings.CraneliftOptLevel);
+		ReadEnum(ProfilerNames, Section, TEXT("Profiler"), ConfigFile, Settings.Profiler);
+
+		GConfig->GetBool(*Section, TEXT("bDebugInfo"), Settings.bDebugInfo, ConfigFile);
+		GConfig->GetBool(*Section, TEXT("bInterruptable"), Settings.bInterruptable, ConfigFile);
+		GConfig->GetBool(*Section, TEXT("bConsumeFuel"), Settings.bConsumeFuel, ConfigFile);
+		GConfig->GetBool(*Section, TEXT("bCraneliftDebugVerifier"), Settings.bCraneliftDebugVerifier, ConfigFile);
+
+		GConfig->GetBool(*Section, TEXT("bWasmThreads"), Settings.bWasmThreads, ConfigFile);
+		GConfig->GetBool(*Section, TEXT("bWasmReferenceTypes"), Settings.bWasmReferenceTypes, ConfigFile);
+		GConfig->GetBool(*Section, TEXT("bWasmSimd"), Settings.bWasmSimd, ConfigFile);
+		GConfig->GetBool(*Section, TEXT("bWasmBulkMemory"), Settings.bWasmBulkMemory, ConfigFile);
+		GConfig->GetBool(*Section, TEXT("bWasmMultiValue"), Settings.bWasmMultiValue, ConfigFile);
+		GConfig->GetBool(*Section, TEXT("bWasmModuleLinking"), Settings.bWasmModuleLinking, ConfigFile);
+
+		GConfig->GetInt64(*Section, TEXT("MaxWasmStack"), Settings.MaxWasmStack, ConfigFile);
+		GConfig->GetInt64(*Section, TEXT("StaticMemoryMaximumSize"), Settings.StaticMemoryMaximumSize, ConfigFile);
+		GConfig->GetInt64(*Section, TEXT("StaticMemoryGuardSize"), Settings.StaticMemoryGuardSize, ConfigFile);
+		GConfig->GetInt64(*Section, TEXT("DynamicMemoryGuardSize"), Settings.DynamicMemoryGuardSize, ConfigFile);
+		GConfig->GetInt64(*Section, TEXT("MaxInstances"), Settings.MaxInstances, ConfigFile);
+		return Settings;
+	}
+
+	bool FWasmEngineSettings::LexPreset(const FString& String, EWasmEnginePreset& OutPreset)
+	{
+		return LexEnum(PresetNames, String, OutPreset);
+	}
+
+	TWasmConfig FWasmEngineSettings::MakeConfig() const
+	{
+		TWasmConfig Config = MakeWasmConfig();
+		wasm_config_t* RawConfig = Config.Get();
+		check(RawConfig);
+
+		HandleError(TEXT("Engine Strategy"), wasmtime_config_strategy_set(RawConfig, Strategy));
+		HandleError(TEXT("Engine Profiler"), wasmtime_config_profiler_set(RawConfig, Profiler));
+		wasmtime_config_cranelift_opt_level_set(RawConfig, CraneliftOptLevel);
+		wasmtime_config_cranelift_debug_verifier_set(RawConfig, bCraneliftDebugVerifier);
+
+		wasmtime_config_debug_info_set(RawConfig, bDebugInfo);
+		wasmtime_config_interruptable_set(RawConfig, bInterruptable);
+		wasmtime_config_consume_fuel_set(RawConfig, bConsumeFuel);
+
+		// Reference types depend on bulk memory and turn it back on, so bulk memory goes first.
+		wasmtime_config_wasm_bulk_memory_set(RawConfig, bWasmBulkMemory);
+		wasmtime_config_wasm_reference_types_set(RawConfig, bWasmReferenceTypes);
+		wasmtime_config_wasm_threads_set(RawConfig, bWasmThreads);
+		wasmtime_config_wasm_simd_set(RawConfig, bWasmSimd);
+		wasmtime_config_wasm_multi_value_set(RawConfig, bWasmMultiValue);
+		wasmtime_config_wasm_module_linking_set(RawConfig, bWasmModuleLinking);
+
+		if (MaxWasmStack >= 0)
+		{
+			wasmtime_config_max_wasm_stack_set(RawConfig, MaxWasmStack);
+		}
+		if (StaticMemoryMaximumSize >= 0)
+		{
+			wasmtime_config_static_memory_maximum_size_set(RawConfig, StaticMemoryMaximumSize);
+		}
+		if (StaticMemoryGuardSize >= 0)
+		{
+			wasmtime_config_static_memory_guard_size_set(RawConfig, StaticMemoryGuardSize);
+		}
+		if (DynamicMemoryGuardSize >= 0)
+		{
+			wasmtime_config_dynamic_memory_guard_size_set(RawConfig, DynamicMemoryGuardSize);
+		}
+		if (MaxInstances >= 0)
+		{
+			wasmtime_config_max_instances_set(RawConfig, MaxInstances);
+		}
+		return Config;
+	}
+
+	FString FWasmEngineSettings::GetConfigKey() const
+	{
+		return FString::Printf(TEXT("S%u O%u P%u D%i I%i F%i V%i T%i R%i SIMD%i B%i M%i L%i Stack%lld SMax%lld SGuard%lld DGuard%lld Inst%lld"),
+		                       Strategy, CraneliftOptLevel, Profiler, bDebugInfo, bInterruptable, bConsumeFuel, bCraneliftDebugVerifier,
+		                       bWasmThreads, bWasmReferenceTypes, bWasmSimd, bWasmBulkMemory, bWasmMultiValue, bWasmModuleLinking,
+		                       MaxWasmStack, StaticMemoryMaximumSize, StaticMemoryGuardSize, DynamicMemoryGuardSize, MaxInstances);
+	}
+
+	const FWasmEngineProfile& GetSharedWasmEngineProfile(const FName& Profile)
+	{
+		// Profiles live until the module shuts down.
+		const FWasmEngineProfilePtr& EngineProfile = FUEWasmTimeModule::Get().GetEngineProfile(Profile);
+		checkf(EngineProfile.IsValid(), TEXT("Failed to create wasm engine for profile %s."), *Profile.ToString());
+		return *EngineProfile;
+	}
+}
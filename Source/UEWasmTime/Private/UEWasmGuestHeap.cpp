@@ -0,0 +1,149 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmGuestHeap.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Guest Heap Arena Reservations"), STAT_WasmGuestHeapReservations, STATGROUP_UEWasmTime);
+
+namespace UEWas
+{
+	bool TWasmGuestHeap::Bind(const TWasmExecutionContext& InContext, const TWasmGuestHeapSettings& InSettings)
+	{
+		Context = nullptr;
+		Settings = InSettings;
+		Arenas.Reset();
+		CurrentArena = 0;
+		NumAllocations = 0;
+		NumGuestCalls = 0;
+
+		if (!AllocFunc.Bind(InContext, Settings.AllocExport))
+		{
+			return false;
+		}
+		if (InContext.FindExport(Settings.FreeExport))
+		{
+			FreeFunc.Bind(InContext, Settings.FreeExport);
+		}
+
+		Context = &InContext;
+		LastResetFrame = GFrameCounter;
+		return true;
+	}
+
+	uint32 TWasmGuestHeap::Allocate(uint64 Size, uint32 Alignment)
+	{
+		check(Context);
+		check(FMath::IsPowerOfTwo(Alignment));
+
+		// The guest allocator takes an i32, an arena has to hold the request plus its alignment padding.
+		const uint64 ArenaSize = Size + Alignment;
+		if (ArenaSize > static_cast<uint64>(MAX_int32))
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Guest heap: %llu bytes don't fit the guest allocator."), Size);
+			return 0;
+		}
+
+		if (Settings.bResetEveryFrame && LastResetFrame != GFrameCounter)
+		{
+			Reset();
+		}
+
+		for (; CurrentArena < Arenas.Num(); CurrentArena++)
+		{
+			TArena& Arena = Arenas[CurrentArena];
+			const uint64 Start = Align(static_cast<uint64>(Arena.Base) + Arena.Used, Alignment);
+			if (Start + Size <= static_cast<uint64>(Arena.Base) + Arena.Size)
+			{
+				Arena.Used = Start + Size - Arena.Base;
+				NumAllocations++;
+				return Start;
+			}
+		}
+
+		if (!ReserveArena(static_cast<uint32>(ArenaSize)))
+		{
+			return 0;
+		}
+		return Allocate(Size, Alignment);
+	}
+
+	uint32 TWasmGuestHeap::WriteString(const FString& String, bool bNullTerminate)
+	{
+		const uint64 Size = WasmUtf8Length(*String, String.Len()) + (bNullTerminate ? 1 : 0);
+		const uint32 Pointer = Allocate(Size, 1);
+		if (Pointer == 0 || WasmMemoryWriteStringAt(*Context, Pointer, Size, String, bNullTerminate) == INDEX_NONE)
+		{
+			return 0;
+		}
+		return Pointer;
+	}
+
+	uint32 TWasmGuestHeap::WriteLengthPrefixedString(const FString& String)
+	{
+		const uint64 Size = WasmLengthPrefixedStringSize(String);
+		const uint32 Pointer = Allocate(Size, alignof(uint32));
+		if (Pointer == 0 || WasmMemoryWriteLengthPrefixedStringAt(*Context, Pointer, Size, String) == INDEX_NONE)
+		{
+			return 0;
+		}
+		return Pointer;
+	}
+
+	void TWasmGuestHeap::Reset()
+	{
+		for (TArena& Arena : Arenas)
+		{
+			Arena.Used = 0;
+		}
+		CurrentArena = 0;
+		NumAllocations = 0;
+		LastResetFrame = GFrameCounter;
+	}
+
+	void TWasmGuestHeap::Release()
+	{
+		if (Context && FreeFunc.IsBound())
+		{
+			for (const TArena& Arena : Arenas)
+			{
+				FreeFunc.Call(static_cast<int32>(Arena.Base));
+				NumGuestCalls++;
+			}
+		}
+		Arenas.Reset();
+		CurrentArena = 0;
+		NumAllocations = 0;
+	}
+
+	TWasmGuestHeapStats TWasmGuestHeap::GetStats() const
+	{
+		TWasmGuestHeapStats Stats;
+		Stats.NumArenas = Arenas.Num();
+		for (const TArena& Arena : Arenas)
+		{
+			Stats.BytesReserved += Arena.Size;
+			Stats.BytesUsed += Arena.Used;
+		}
+		Stats.NumAllocations = NumAllocations;
+		Stats.NumGuestCalls = NumGuestCalls;
+		return Stats;
+	}
+
+	bool TWasmGuestHeap::ReserveArena(uint32 MinSize)
+	{
+		const uint32 Size = FMath::Max(Settings.ArenaSize, MinSize);
+		int32 Base = 0;
+		NumGuestCalls++;
+		if (!AllocFunc.Call(static_cast<int32>(Size), Base) || Base == 0)
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Guest heap: %s failed to reserve %u bytes."), *Settings.AllocExport.ToString(), Size);
+			return false;
+		}
+
+		INC_DWORD_STAT(STAT_WasmGuestHeapReservations);
+		TArena& Arena = Arenas.AddDefaulted_GetRef();
+		Arena.Base = static_cast<uint32>(Base);
+		Arena.Size = Size;
+		CurrentArena = Arenas.Num() - 1;
+		return true;
+	}
+}
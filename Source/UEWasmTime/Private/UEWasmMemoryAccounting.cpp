@@ -0,0 +1,219 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmMemoryAccounting.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+#include "UEWasmContextPool.h"
+
+DECLARE_MEMORY_STAT(TEXT("Contexts Linear Memory"), STAT_WasmAccountedMemory, STATGROUP_UEWasmTime);
+DECLARE_MEMORY_STAT(TEXT("Contexts Tables"), STAT_WasmAccountedTables, STATGROUP_UEWasmTime);
+DECLARE_MEMORY_STAT(TEXT("Contexts Store Overhead"), STAT_WasmAccountedStores, STATGROUP_UEWasmTime);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Live Contexts"), STAT_WasmLiveContexts, STATGROUP_UEWasmTime);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Context Evictions"), STAT_WasmContextEvictions, STATGROUP_UEWasmTime);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Context Rejections"), STAT_WasmContextRejections, STATGROUP_UEWasmTime);
+
+static TAutoConsoleVariable<int32> CVarWasmMemoryGlobalBudgetMB(
+	TEXT("wasm.Memory.GlobalBudgetMB"),
+	0,
+	TEXT("Memory all wasm contexts together may use before idle pooled contexts are evicted and new ones refused, 0 for no limit."));
+
+static TAutoConsoleVariable<int32> CVarWasmMemoryContextBudgetMB(
+	TEXT("wasm.Memory.ContextBudgetMB"),
+	0,
+	TEXT("Memory a single wasm context may use, 0 for no limit."));
+
+static TAutoConsoleVariable<int32> CVarWasmMemoryStoreOverheadKB(
+	TEXT("wasm.Memory.StoreOverheadKB"),
+	256,
+	TEXT("Estimated memory a wasm store takes besides its memories and tables, wasmtime doesn't report it."));
+
+namespace UEWas
+{
+	TWasmMemoryAccounting& TWasmMemoryAccounting::Get()
+	{
+		static TWasmMemoryAccounting Accounting;
+		return Accounting;
+	}
+
+	bool TWasmMemoryAccounting::AddContext(const TWasmExecutionContext* Context, const TWasmMemoryUsage& Usage, FString& OutError)
+	{
+		const uint64 ContextBudget = GetContextBudget();
+		if (ContextBudget > 0 && Usage.GetTotal() > ContextBudget)
+		{
+			OutError = FString::Printf(TEXT("Context needs %llu bytes, over the per context budget of %llu."), Usage.GetTotal(), ContextBudget);
+		}
+		else if (!EvictUntilFits(Usage.GetTotal(), true))
+		{
+			OutError = FString::Printf(TEXT("Context needs %llu bytes, the global budget of %llu is used up."), Usage.GetTotal(), GetGlobalBudget());
+		}
+		else
+		{
+			FScopeLock ScopeLock(&Lock);
+			PendingBytes -= Usage.GetTotal();
+			Contexts.Add(Context, Usage);
+			Total += Usage;
+			PeakBytes = FMath::Max(PeakBytes, Total.GetTotal());
+			UpdateStats();
+			return true;
+		}
+
+		{
+			FScopeLock ScopeLock(&Lock);
+			Rejections++;
+		}
+		INC_DWORD_STAT(STAT_WasmContextRejections);
+		return false;
+	}
+
+	void TWasmMemoryAccounting::UpdateContext(const TWasmExecutionContext* Context, const TWasmMemoryUsage& Usage)
+	{
+		uint64 TotalBytes = 0;
+		{
+			FScopeLock ScopeLock(&Lock);
+			TWasmMemoryUsage* Existing = Contexts.Find(Context);
+			if (!Existing)
+			{
+				return;
+			}
+			Total -= *Existing;
+			Total += Usage;
+			*Existing = Usage;
+			TotalBytes = Total.GetTotal();
+			PeakBytes = FMath::Max(PeakBytes, TotalBytes);
+			UpdateStats();
+		}
+
+		const uint64 ContextBudget = GetContextBudget();
+		if (ContextBudget > 0 && Usage.GetTotal() > ContextBudget)
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Context uses %llu bytes, over the per context budget of %llu."), Usage.GetTotal(), ContextBudget);
+		}
+
+		const uint64 GlobalBudget = GetGlobalBudget();
+		if (GlobalBudget > 0 && TotalBytes > GlobalBudget && !MakeRoom(0))
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Wasm contexts use %llu bytes, over the global budget of %llu with nothing left to evict."),
+			       TotalBytes, GlobalBudget);
+		}
+	}
+
+	void TWasmMemoryAccounting::RemoveContext(const TWasmExecutionContext* Context)
+	{
+		FScopeLock ScopeLock(&Lock);
+		TWasmMemoryUsage Usage;
+		if (Contexts.RemoveAndCopyValue(Context, Usage))
+		{
+			Total -= Usage;
+			UpdateStats();
+		}
+	}
+
+	bool TWasmMemoryAccounting::FindContextUsage(const TWasmExecutionContext* Context, TWasmMemoryUsage& OutUsage) const
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (const TWasmMemoryUsage* Usage = Contexts.Find(Context))
+		{
+			OutUsage = *Usage;
+			return true;
+		}
+		return false;
+	}
+
+	TWasmMemoryAccountingStats TWasmMemoryAccounting::GetStats() const
+	{
+		FScopeLock ScopeLock(&Lock);
+		TWasmMemoryAccountingStats Stats;
+		Stats.Total = Total;
+		Stats.PeakBytes = PeakBytes;
+		Stats.NumContexts = Contexts.Num();
+		Stats.Evictions = Evictions;
+		Stats.Rejections = Rejections;
+		return Stats;
+	}
+
+	void TWasmMemoryAccounting::AddEvictionSource(const TWeakPtr<TWasmContextPool, ESPMode::ThreadSafe>& Pool)
+	{
+		FScopeLock ScopeLock(&Lock);
+		EvictionSources.RemoveAll([](const TWeakPtr<TWasmContextPool, ESPMode::ThreadSafe>& Source) { return !Source.IsValid(); });
+		EvictionSources.Add(Pool);
+	}
+
+	bool TWasmMemoryAccounting::MakeRoom(uint64 Bytes)
+	{
+		return EvictUntilFits(Bytes, false);
+	}
+
+	bool TWasmMemoryAccounting::EvictUntilFits(uint64 Bytes, bool bReserve)
+	{
+		const uint64 GlobalBudget = GetGlobalBudget();
+		while (true)
+		{
+			TArray<TSharedPtr<TWasmContextPool, ESPMode::ThreadSafe>> Sources;
+			{
+				FScopeLock ScopeLock(&Lock);
+				if (GlobalBudget == 0 || Total.GetTotal() + PendingBytes + Bytes <= GlobalBudget)
+				{
+					if (bReserve)
+					{
+						PendingBytes += Bytes;
+					}
+					return true;
+				}
+				for (const TWeakPtr<TWasmContextPool, ESPMode::ThreadSafe>& Source : EvictionSources)
+				{
+					if (TSharedPtr<TWasmContextPool, ESPMode::ThreadSafe> Pool = Source.Pin())
+					{
+						Sources.Add(MoveTemp(Pool));
+					}
+				}
+			}
+
+			// Evicting destroys a context, which removes itself from the accounting, so it happens outside the lock.
+			TSharedPtr<TWasmContextPool, ESPMode::ThreadSafe> Oldest;
+			double OldestIdleTime = MAX_dbl;
+			for (const TSharedPtr<TWasmContextPool, ESPMode::ThreadSafe>& Pool : Sources)
+			{
+				double IdleTime = 0.0;
+				if (Pool->GetOldestIdleTime(IdleTime) && IdleTime < OldestIdleTime)
+				{
+					OldestIdleTime = IdleTime;
+					Oldest = Pool;
+				}
+			}
+
+			if (!Oldest.IsValid() || !Oldest->EvictOldestIdle())
+			{
+				return false;
+			}
+
+			{
+				FScopeLock ScopeLock(&Lock);
+				Evictions++;
+			}
+			INC_DWORD_STAT(STAT_WasmContextEvictions);
+		}
+	}
+
+	uint64 TWasmMemoryAccounting::GetGlobalBudget()
+	{
+		return static_cast<uint64>(FMath::Max(CVarWasmMemoryGlobalBudgetMB.GetValueOnAnyThread(), 0)) * 1024 * 1024;
+	}
+
+	uint64 TWasmMemoryAccounting::GetContextBudget()
+	{
+		return static_cast<uint64>(FMath::Max(CVarWasmMemoryContextBudgetMB.GetValueOnAnyThread(), 0)) * 1024 * 1024;
+	}
+
+	uint64 TWasmMemoryAccounting::GetStoreOverhead()
+	{
+		return static_cast<uint64>(FMath::Max(CVarWasmMemoryStoreOverheadKB.GetValueOnAnyThread(), 0)) * 1024;
+	}
+
+	void TWasmMemoryAccounting::UpdateStats() const
+	{
+		SET_MEMORY_STAT(STAT_WasmAccountedMemory, Total.MemoryBytes);
+		SET_MEMORY_STAT(STAT_WasmAccountedTables, Total.TableBytes);
+		SET_MEMORY_STAT(STAT_WasmAccountedStores, Total.StoreBytes);
+		SET_DWORD_STAT(STAT_WasmLiveContexts, Contexts.Num());
+	}
+}
@@ -0,0 +1,162 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmModuleCache.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Module Cache Hits"), STAT_WasmModuleCacheHits, STATGROUP_UEWasmTime);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Module Cache Misses"), STAT_WasmModuleCacheMisses, STATGROUP_UEWasmTime);
+DECLARE_CYCLE_STAT(TEXT("Module Cache Lookup"), STAT_WasmModuleCacheLookup, STATGROUP_UEWasmTime);
+DECLARE_CYCLE_STAT(TEXT("Module Compile"), STAT_WasmModuleCompile, STATGROUP_UEWasmTime);
+
+static TAutoConsoleVariable<bool> CVarWasmModuleCacheEnabled(
+	TEXT("wasm.ModuleCache.Enabled"),
+	true,
+	TEXT("When enabled compiled wasm modules are stored on disk and reloaded instead of being compiled again."));
+
+namespace UEWas
+{
+	TWasmModuleCache::TWasmModuleCache(const FString& InCacheDirectory)
+		: CacheDirectory(InCacheDirectory), Hits(0), Misses(0), Writes(0), Rejected(0)
+	{
+	}
+
+	TWasmModuleCache& TWasmModuleCache::Get()
+	{
+		static TWasmModuleCache Cache(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("WasmModuleCache")));
+		return Cache;
+	}
+
+	FString TWasmModuleCache::MakeKey(const TWasmByteVec& Binary, const FString& EngineConfigKey) const
+	{
+		checkf(!EngineConfigKey.IsEmpty(), TEXT("Modules are keyed per engine configuration, pass the engine profile's ConfigKey."));
+
+		// Native artifacts are only valid for the wasmtime build, engine configuration and platform that produced them.
+		const FString Environment = FString::Printf(TEXT("%s|%s|%s"), TEXT(WASMTIME_VERSION), FPlatformProperties::IniPlatformName(),
+		                                            *EngineConfigKey);
+
+		FSHA1 Hash;
+		Hash.UpdateWithString(*Environment, Environment.Len());
+		if (Binary.Get() && Binary.Get()->Value.size > 0)
+		{
+			Hash.Update(reinterpret_cast<const uint8*>(Binary.Get()->Value.data), Binary.Get()->Value.size);
+		}
+		Hash.Final();
+
+		FSHAHash Key;
+		Hash.GetHash(Key.Hash);
+		return Key.ToString();
+	}
+
+	TWasmModule TWasmModuleCache::FindOrCompile(const TWasmEngine& Engine, const TWasmByteVec& Binary, FString& OutErrorString,
+	                                            const FString& EngineConfigKey)
+	{
+		check(Engine.Get());
+		check(Binary.Get());
+
+		if (!CVarWasmModuleCacheEnabled.GetValueOnAnyThread())
+		{
+			SCOPE_CYCLE_COUNTER(STAT_WasmModuleCompile);
+			return MakeWasmModule(Engine, Binary, OutErrorString);
+		}
+
+		const FString& Key = MakeKey(Binary, EngineConfigKey);
+		TWasmModule Module = Find(Engine, Key);
+		if (Module.IsValid())
+		{
+			return Module;
+		}
+
+		{
+			SCOPE_CYCLE_COUNTER(STAT_WasmModuleCompile);
+			Module = MakeWasmModule(Engine, Binary, OutErrorString);
+		}
+
+		if (Module.IsValid())
+		{
+			Add(Key, Module);
+		}
+		return Module;
+	}
+
+	TWasmModule TWasmModuleCache::Find(const TWasmEngine& Engine, const FString& Key)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmModuleCacheLookup);
+
+		TArray<uint8> Artifact;
+		if (FFileHelper::LoadFileToArray(Artifact, *GetArtifactPath(Key), FILEREAD_Silent))
+		{
+			FString Error;
+			TWasmModule Module = MakeWasmModuleFromSerialized(Engine, Artifact.GetData(), Artifact.Num(), Error);
+			if (Module.IsValid())
+			{
+				++Hits;
+				INC_DWORD_STAT(STAT_WasmModuleCacheHits);
+				return Module;
+			}
+
+			UE_LOG(LogUEWasmTime, Log, TEXT("Discarding cached module artifact %s: %s"), *Key, *Error);
+			++Rejected;
+			Remove(Key);
+		}
+
+		++Misses;
+		INC_DWORD_STAT(STAT_WasmModuleCacheMisses);
+		return {};
+	}
+
+	bool TWasmModuleCache::Add(const FString& Key, const TWasmModule& Module)
+	{
+		FString Error;
+		const TWasmByteVec& Serialized = WasmModuleSerialize(Module, Error);
+		if (!Serialized.IsValid())
+		{
+			return false;
+		}
+
+		// Write to a temporary file first so concurrent readers never see a partially written artifact.
+		const FString& ArtifactPath = GetArtifactPath(Key);
+		const FString& TempPath = FPaths::CreateTempFilename(*CacheDirectory, TEXT("Artifact"), TEXT(".tmp"));
+		const TArrayView<const uint8> Data(reinterpret_cast<const uint8*>(Serialized.Get()->Value.data), Serialized.Get()->Value.size);
+		if (FFileHelper::SaveArrayToFile(Data, *TempPath) && IFileManager::Get().Move(*ArtifactPath, *TempPath))
+		{
+			++Writes;
+			return true;
+		}
+
+		UE_LOG(LogUEWasmTime, Warning, TEXT("Failed to write cached module artifact %s"), *ArtifactPath);
+		IFileManager::Get().Delete(*TempPath, false, false, true);
+		return false;
+	}
+
+	void TWasmModuleCache::Remove(const FString& Key)
+	{
+		IFileManager::Get().Delete(*GetArtifactPath(Key), false, false, true);
+	}
+
+	TWasmModuleCacheStats TWasmModuleCache::GetStats() const
+	{
+		TWasmModuleCacheStats Stats;
+		Stats.Hits = Hits;
+		Stats.Misses = Misses;
+		Stats.Writes = Writes;
+		Stats.Rejected = Rejected;
+		return Stats;
+	}
+
+	void TWasmModuleCache::ResetStats()
+	{
+		Hits = 0;
+		Misses = 0;
+		Writes = 0;
+		Rejected = 0;
+	}
+
+	FString TWasmModuleCache::GetArtifactPath(const FString& Key) const
+	{
+		return FPaths::Combine(CacheDirectory, Key + TEXT(".cwasm"));
+	}
+}
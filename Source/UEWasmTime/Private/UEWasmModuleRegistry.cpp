@@ -0,0 +1,94 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmModuleRegistry.h"
+#include "Misc/ScopeLock.h"
+#include "UEWasmModuleCache.h"
+
+namespace UEWas
+{
+	TWasmModuleRegistry& TWasmModuleRegistry::Get()
+	{
+		static TWasmModuleRegistry Registry;
+		return Registry;
+	}
+
+	TWasmModuleHandle TWasmModuleRegistry::FindOrAdd(const TWasmEngine& Engine, const TWasmByteVec& Binary, FString& OutErrorString,
+	                                                 const FString& EngineConfigKey)
+	{
+		const FString& Key = TWasmModuleCache::Get().MakeKey(Binary, EngineConfigKey);
+		if (TWasmModuleHandle Existing = Find(Engine, Key))
+		{
+			return Existing;
+		}
+
+		// Compile outside the lock, if another thread registers the same module meanwhile Add hands out its entry instead.
+		const TWasmModule& Module = MakeWasmModuleCached(Engine, Binary, OutErrorString, EngineConfigKey);
+		if (!Module.IsValid())
+		{
+			return {};
+		}
+		return Add(Engine, Key, Module);
+	}
+
+	TWasmModuleHandle TWasmModuleRegistry::Add(const TWasmEngine& Engine, const FString& Key, const TWasmModule& Module)
+	{
+		check(Engine.Get());
+		check(Module.Get());
+
+		const FEntryKey EntryKey(Engine.Get(), Key);
+		FScopeLock ScopeLock(&Lock);
+		if (const TWeakPtr<const TWasmModuleEntry, ESPMode::ThreadSafe>* Existing = Modules.Find(EntryKey))
+		{
+			if (TWasmModuleHandle Pinned = Existing->Pin())
+			{
+				return Pinned;
+			}
+		}
+
+		TSharedRef<TWasmModuleEntry, ESPMode::ThreadSafe> Entry = MakeShared<TWasmModuleEntry, ESPMode::ThreadSafe>();
+		Entry->Key = Key;
+		Entry->Engine = Engine.Get();
+		Entry->SharedModule = WasmModuleShare(Module);
+		Entry->ExternMap = *GenerateWasmExternMap(Module);
+		Entry->ImportMap = *GenerateWasmImportMap(Module);
+
+		RemoveStaleEntries();
+		Modules.Emplace(EntryKey, Entry);
+		return Entry;
+	}
+
+	TWasmModuleHandle TWasmModuleRegistry::Find(const TWasmEngine& Engine, const FString& Key) const
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (const TWeakPtr<const TWasmModuleEntry, ESPMode::ThreadSafe>* Existing = Modules.Find(FEntryKey(Engine.Get(), Key)))
+		{
+			return Existing->Pin();
+		}
+		return {};
+	}
+
+	int32 TWasmModuleRegistry::Num() const
+	{
+		FScopeLock ScopeLock(&Lock);
+		int32 NumAlive = 0;
+		for (const auto& Pair : Modules)
+		{
+			if (Pair.Value.IsValid())
+			{
+				NumAlive++;
+			}
+		}
+		return NumAlive;
+	}
+
+	void TWasmModuleRegistry::RemoveStaleEntries()
+	{
+		for (auto It = Modules.CreateIterator(); It; ++It)
+		{
+			if (!It->Value.IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
@@ -0,0 +1,112 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmParallelFor.h"
+#include "UEWasmModuleRegistry.h"
+
+DECLARE_CYCLE_STAT(TEXT("Parallel For"), STAT_WasmParallelFor, STATGROUP_UEWasmTime);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Parallel For Chunks"), STAT_WasmParallelForChunks, STATGROUP_UEWasmTime);
+
+namespace UEWas
+{
+	FWasmParallelKernel::FWasmParallelKernel(FWasmRuntime& InRuntime, const TWasmModuleHandle& Module, const FWasmEngineProfilePtr& EngineProfile,
+	                                         const FName& InExportName, const TArray<TWasmFunctionSignaturePtr>& HostFunctions,
+	                                         const FString& WorkspacePath)
+		: Runtime(InRuntime), ExportName(InExportName)
+	{
+		check(Runtime.GetCurrentWorker() == INDEX_NONE);
+
+		// Every replica obtains the registry's shared module, compiled code exists once.
+		TArray<TFuture<FWasmRuntimeContextHandle>> Created;
+		for (int32 Worker = 0; Worker < Runtime.GetNumWorkers(); Worker++)
+		{
+			Created.Add(Runtime.CreateContext(Module, EngineProfile, HostFunctions, WorkspacePath, Worker));
+		}
+
+		Replicas.SetNum(Created.Num());
+		TArray<TFuture<bool>> Bound;
+		for (int32 Index = 0; Index < Created.Num(); Index++)
+		{
+			FReplica& Replica = Replicas[Index];
+			Replica.Handle = Created[Index].Get();
+			Bound.Add(Runtime.Execute(Replica.Handle, [&Replica, this](TWasmExecutionContext& Context)
+			{
+				return Replica.Func.Bind(Context, ExportName);
+			}));
+		}
+
+		bValid = Replicas.Num() > 0;
+		for (TFuture<bool>& Future : Bound)
+		{
+			bValid &= Future.Get();
+		}
+		if (!bValid)
+		{
+			UE_LOG(LogUEWasmTime, Error, TEXT("Parallel kernel %s of module %s couldn't be set up on every worker."), *ExportName.ToString(),
+			       *Module->Key);
+		}
+	}
+
+	FWasmParallelKernel::~FWasmParallelKernel()
+	{
+		for (const FReplica& Replica : Replicas)
+		{
+			Runtime.DestroyContext(Replica.Handle);
+		}
+	}
+
+	bool FWasmParallelKernel::Run(int32 Begin, int32 End, int32 Grain)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmParallelFor);
+		check(Runtime.GetCurrentWorker() == INDEX_NONE);
+
+		if (End <= Begin)
+		{
+			return true;
+		}
+		if (!bValid)
+		{
+			return false;
+		}
+
+		Grain = FMath::Max(Grain, 1);
+		const int32 NumChunks = static_cast<int32>(FMath::DivideAndRoundUp<int64>(static_cast<int64>(End) - Begin, Grain));
+		INC_DWORD_STAT_BY(STAT_WasmParallelForChunks, NumChunks);
+
+		// Replicas claim chunk indices from one counter, a chunk costs a single atomic increment.
+		TSharedRef<std::atomic<int32>, ESPMode::ThreadSafe> NextChunk = MakeShared<std::atomic<int32>, ESPMode::ThreadSafe>(0);
+
+		TArray<TFuture<bool>> Futures;
+		const int32 NumReplicas = FMath::Min(Replicas.Num(), NumChunks);
+		for (int32 Index = 0; Index < NumReplicas; Index++)
+		{
+			const TKernelFunc& Func = Replicas[Index].Func;
+			Futures.Add(Runtime.Execute(Replicas[Index].Handle, [&Func, NextChunk, NumChunks, Begin, End, Grain](TWasmExecutionContext&)
+			{
+				for (int32 Chunk = (*NextChunk)++; Chunk < NumChunks; Chunk = (*NextChunk)++)
+				{
+					const int64 ChunkBegin = Begin + static_cast<int64>(Chunk) * Grain;
+					const int64 ChunkEnd = FMath::Min<int64>(ChunkBegin + Grain, End);
+					if (!Func.Call(static_cast<int32>(ChunkBegin), static_cast<int32>(ChunkEnd)))
+					{
+						return false;
+					}
+				}
+				return true;
+			}));
+		}
+
+		bool bSuccess = true;
+		for (TFuture<bool>& Future : Futures)
+		{
+			bSuccess &= Future.Get();
+		}
+		return bSuccess;
+	}
+
+	bool WasmParallelFor(FWasmRuntime& Runtime, const TWasmModuleHandle& Module, const FWasmEngineProfilePtr& EngineProfile,
+	                     const FName& ExportName, int32 Begin, int32 End, int32 Grain)
+	{
+		FWasmParallelKernel Kernel(Runtime, Module, EngineProfile, ExportName);
+		return Kernel.Run(Begin, End, Grain);
+	}
+}
@@ -0,0 +1,778 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmPreInit.h"
+#include "Misc/Paths.h"
+#include "UEWasmTypedFunc.h"
+
+namespace UEWas
+{
+	static constexpr uint8 WasmSectionCustom = 0;
+	static constexpr uint8 WasmSectionImport = 2;
+	static constexpr uint8 WasmSectionMemory = 5;
+	static constexpr uint8 WasmSectionGlobal = 6;
+	static constexpr uint8 WasmSectionExport = 7;
+	static constexpr uint8 WasmSectionStart = 8;
+	static constexpr uint8 WasmSectionData = 11;
+	static constexpr uint8 WasmSectionDataCount = 12;
+
+	static constexpr uint8 WasmExternFunc = 0;
+	static constexpr uint8 WasmExternTable = 1;
+	static constexpr uint8 WasmExternMemory = 2;
+	static constexpr uint8 WasmExternGlobal = 3;
+
+	static constexpr uint8 WasmOpEnd = 0x0B;
+	static constexpr uint8 WasmOpGlobalGet = 0x23;
+	static constexpr uint8 WasmOpI32Const = 0x41;
+	static constexpr uint8 WasmOpI64Const = 0x42;
+	static constexpr uint8 WasmOpF32Const = 0x43;
+	static constexpr uint8 WasmOpF64Const = 0x44;
+	static constexpr uint8 WasmOpRefNull = 0xD0;
+	static constexpr uint8 WasmOpRefFunc = 0xD2;
+	static constexpr uint8 WasmOpSimdPrefix = 0xFD;
+	static constexpr uint32 WasmOpV128Const = 12;
+
+	static constexpr uint8 WasmTypeI32 = 0x7F;
+	static constexpr uint8 WasmTypeI64 = 0x7E;
+	static constexpr uint8 WasmTypeF32 = 0x7D;
+	static constexpr uint8 WasmTypeF64 = 0x7C;
+
+	static constexpr uint64 WasmPageSize = 65536;
+	static constexpr int32 WasmHeaderSize = 8;
+
+	static const TCHAR* PreInitMemoryExport = TEXT("__ue_preinit_memory");
+	static const TCHAR* PreInitGlobalExport = TEXT("__ue_preinit_global_");
+	static const TCHAR* ReactorInitExport = TEXT("_initialize");
+
+	/** Zero runs shorter than this stay inside a data segment, every segment costs a few bytes of header. */
+	static constexpr uint64 MinDataSegmentGap = 16;
+
+	/**
+	 * Position in the binary section order, custom sections can go anywhere.
+	 */
+	static int32 GetSectionRank(uint8 Id)
+	{
+		// Data count goes between element and code.
+		static const int32 Ranks[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 12, 10};
+		return Id < UE_ARRAY_COUNT(Ranks) ? Ranks[Id] : INDEX_NONE;
+	}
+
+	struct FWasmBinaryReader
+	{
+		const uint8* Data;
+		int64 Size;
+		int64 Offset;
+		bool bError = false;
+
+		FWasmBinaryReader(const uint8* InData, int64 InSize, int64 InOffset = 0)
+			: Data(InData), Size(InSize), Offset(InOffset)
+		{
+		}
+
+		uint8 ReadByte()
+		{
+			if (Offset >= Size)
+			{
+				bError = true;
+				return 0;
+			}
+			return Data[Offset++];
+		}
+
+		uint64 ReadVarUInt()
+		{
+			uint64 Result = 0;
+			uint32 Shift = 0;
+			uint8 Byte;
+			do
+			{
+				Byte = ReadByte();
+				if (Shift < 64)
+				{
+					Result |= uint64(Byte & 0x7F) << Shift;
+				}
+				Shift += 7;
+			}
+			while ((Byte & 0x80) && !bError && Shift < 70);
+			return Result;
+		}
+
+		int64 ReadVarInt()
+		{
+			uint64 Result = 0;
+			uint32 Shift = 0;
+			uint8 Byte;
+			do
+			{
+				Byte = ReadByte();
+				if (Shift < 64)
+				{
+					Result |= uint64(Byte & 0x7F) << Shift;
+				}
+				Shift += 7;
+			}
+			while ((Byte & 0x80) && !bError && Shift < 70);
+
+			if (Shift < 64 && (Byte & 0x40))
+			{
+				Result |= ~uint64(0) << Shift;
+			}
+			return static_cast<int64>(Result);
+		}
+
+		void Skip(uint64 Num)
+		{
+			if (Num > uint64(Size - Offset))
+			{
+				bError = true;
+				Offset = Size;
+				return;
+			}
+			Offset += Num;
+		}
+
+		FString ReadName()
+		{
+			const uint64 Length = ReadVarUInt();
+			const int64 Start = Offset;
+			Skip(Length);
+			if (bError)
+			{
+				return TEXT("");
+			}
+			return FString(FUTF8ToTCHAR(reinterpret_cast<const ANSICHAR*>(Data + Start), Length));
+		}
+
+		void ReadLimits(uint8& OutFlags, uint64& OutMin, uint64& OutMax)
+		{
+			OutFlags = ReadByte();
+			OutMin = ReadVarUInt();
+			OutMax = (OutFlags & 1) ? ReadVarUInt() : 0;
+		}
+
+		/**
+		 * Skips a constant expression including its end opcode.
+		 */
+		bool SkipConstExpr()
+		{
+			while (!bError)
+			{
+				switch (ReadByte())
+				{
+				case WasmOpEnd:
+					return true;
+				case WasmOpI32Const:
+				case WasmOpI64Const:
+					ReadVarInt();
+					break;
+				case WasmOpF32Const:
+					Skip(4);
+					break;
+				case WasmOpF64Const:
+					Skip(8);
+					break;
+				case WasmOpGlobalGet:
+				case WasmOpRefFunc:
+					ReadVarUInt();
+					break;
+				case WasmOpRefNull:
+					ReadByte();
+					break;
+				case WasmOpSimdPrefix:
+					if (ReadVarUInt() != WasmOpV128Const)
+					{
+						bError = true;
+						return false;
+					}
+					Skip(16);
+					break;
+				default:
+					bError = true;
+					return false;
+				}
+			}
+			return false;
+		}
+	};
+
+	struct FWasmBinaryWriter
+	{
+		TArray<uint8>& Out;
+
+		explicit FWasmBinaryWriter(TArray<uint8>& InOut)
+			: Out(InOut)
+		{
+		}
+
+		void WriteByte(uint8 Byte)
+		{
+			Out.Add(Byte);
+		}
+
+		void WriteBytes(const uint8* Data, int64 Num)
+		{
+			Out.Append(Data, Num);
+		}
+
+		void WriteVarUInt(uint64 Value)
+		{
+			do
+			{
+				uint8 Byte = Value & 0x7F;
+				Value >>= 7;
+				if (Value != 0)
+				{
+					Byte |= 0x80;
+				}
+				Out.Add(Byte);
+			}
+			while (Value != 0);
+		}
+
+		void WriteVarInt(int64 Value)
+		{
+			bool bMore = true;
+			while (bMore)
+			{
+				uint8 Byte = Value & 0x7F;
+				// Arithmetic shift keeps the sign.
+				Value >>= 7;
+				bMore = !((Value == 0 && !(Byte & 0x40)) || (Value == -1 && (Byte & 0x40)));
+				Out.Add(bMore ? Byte | 0x80 : Byte);
+			}
+		}
+
+		void WriteName(const FString& Name)
+		{
+			const FTCHARToUTF8 Utf8(*Name);
+			WriteVarUInt(Utf8.Length());
+			WriteBytes(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+		}
+
+		void WriteSection(uint8 Id, const TArray<uint8>& Payload)
+		{
+			WriteByte(Id);
+			WriteVarUInt(Payload.Num());
+			Out.Append(Payload);
+		}
+	};
+
+	struct FWasmSectionRange
+	{
+		uint8 Id;
+		/** Start of the section header. */
+		int64 Start;
+		int64 PayloadOffset;
+		int64 PayloadSize;
+	};
+
+	struct FWasmGlobalDesc
+	{
+		uint8 ValType;
+		bool bMutable;
+		int64 InitExprOffset;
+		int64 InitExprSize;
+	};
+
+	struct FWasmModuleLayout
+	{
+		TArray<FWasmSectionRange> Sections;
+		uint32 NumImportedGlobals = 0;
+		uint32 NumImportedMemories = 0;
+		uint32 NumMemories = 0;
+		uint8 MemoryFlags = 0;
+		uint64 MemoryMinPages = 0;
+		uint64 MemoryMaxPages = 0;
+		TArray<FWasmGlobalDesc> Globals;
+
+		const FWasmSectionRange* FindSection(uint8 Id) const
+		{
+			return Sections.FindByPredicate([Id](const FWasmSectionRange& Section) { return Section.Id == Id; });
+		}
+	};
+
+	static bool ParseWasmModule(const TArray<uint8>& Binary, FWasmModuleLayout& OutLayout, FString& OutErrorString)
+	{
+		static const uint8 Header[WasmHeaderSize] = {0x00, 0x61, 0x73, 0x6D, 0x01, 0x00, 0x00, 0x00};
+		if (Binary.Num() < WasmHeaderSize || FMemory::Memcmp(Binary.GetData(), Header, WasmHeaderSize) != 0)
+		{
+			OutErrorString = TEXT("Not a version 1 wasm binary.");
+			return false;
+		}
+
+		FWasmBinaryReader Reader(Binary.GetData(), Binary.Num(), WasmHeaderSize);
+		while (Reader.Offset < Reader.Size && !Reader.bError)
+		{
+			FWasmSectionRange Section;
+			Section.Start = Reader.Offset;
+			Section.Id = Reader.ReadByte();
+			Section.PayloadSize = Reader.ReadVarUInt();
+			Section.PayloadOffset = Reader.Offset;
+			Reader.Skip(Section.PayloadSize);
+			if (Reader.bError)
+			{
+				break;
+			}
+
+			if (GetSectionRank(Section.Id) == INDEX_NONE)
+			{
+				OutErrorString = FString::Printf(TEXT("Unsupported section %u."), Section.Id);
+				return false;
+			}
+			if (Section.Id != WasmSectionCustom && OutLayout.FindSection(Section.Id))
+			{
+				OutErrorString = FString::Printf(TEXT("Duplicate section %u."), Section.Id);
+				return false;
+			}
+			OutLayout.Sections.Add(Section);
+
+			FWasmBinaryReader Payload(Binary.GetData(), Section.PayloadOffset + Section.PayloadSize, Section.PayloadOffset);
+			if (Section.Id == WasmSectionImport)
+			{
+				const uint64 NumImports = Payload.ReadVarUInt();
+				for (uint64 Index = 0; Index < NumImports && !Payload.bError; Index++)
+				{
+					Payload.ReadName();
+					Payload.ReadName();
+					uint8 Flags;
+					uint64 Min, Max;
+					switch (Payload.ReadByte())
+					{
+					case WasmExternFunc:
+						Payload.ReadVarUInt();
+						break;
+					case WasmExternTable:
+						Payload.ReadByte();
+						Payload.ReadLimits(Flags, Min, Max);
+						break;
+					case WasmExternMemory:
+						Payload.ReadLimits(Flags, Min, Max);
+						OutLayout.NumImportedMemories++;
+						break;
+					case WasmExternGlobal:
+						Payload.ReadByte();
+						Payload.ReadByte();
+						OutLayout.NumImportedGlobals++;
+						break;
+					default:
+						OutErrorString = TEXT("Unsupported import kind.");
+						return false;
+					}
+				}
+			}
+			else if (Section.Id == WasmSectionMemory)
+			{
+				OutLayout.NumMemories = Payload.ReadVarUInt();
+				for (uint32 Index = 0; Index < OutLayout.NumMemories && !Payload.bError; Index++)
+				{
+					Payload.ReadLimits(OutLayout.MemoryFlags, OutLayout.MemoryMinPages, OutLayout.MemoryMaxPages);
+				}
+			}
+			else if (Section.Id == WasmSectionGlobal)
+			{
+				const uint64 NumGlobals = Payload.ReadVarUInt();
+				for (uint64 Index = 0; Index < NumGlobals && !Payload.bError; Index++)
+				{
+					FWasmGlobalDesc Global;
+					Global.ValType = Payload.ReadByte();
+					Global.bMutable = Payload.ReadByte() != 0;
+					Global.InitExprOffset = Payload.Offset;
+					Payload.SkipConstExpr();
+					Global.InitExprSize = Payload.Offset - Global.InitExprOffset;
+					OutLayout.Globals.Add(Global);
+				}
+			}
+			else if (Section.Id == WasmSectionData)
+			{
+				const uint64 NumSegments = Payload.ReadVarUInt();
+				for (uint64 Index = 0; Index < NumSegments && !Payload.bError; Index++)
+				{
+					const uint64 Flags = Payload.ReadVarUInt();
+					if (Flags == 1)
+					{
+						// memory.init could copy the original bytes over the captured state.
+						OutErrorString = TEXT("Modules with passive data segments can't be pre-initialized.");
+						return false;
+					}
+					if (Flags == 2 && Payload.ReadVarUInt() != 0)
+					{
+						OutErrorString = TEXT("Data segments for memories other than 0 aren't supported.");
+						return false;
+					}
+					Payload.SkipConstExpr();
+					Payload.Skip(Payload.ReadVarUInt());
+				}
+			}
+
+			if (Payload.bError)
+			{
+				OutErrorString = FString::Printf(TEXT("Malformed section %u."), Section.Id);
+				return false;
+			}
+		}
+
+		if (Reader.bError)
+		{
+			OutErrorString = TEXT("Truncated wasm binary.");
+			return false;
+		}
+		if (OutLayout.NumImportedMemories > 0)
+		{
+			OutErrorString = TEXT("Modules importing their memory can't be pre-initialized, the state lives outside of them.");
+			return false;
+		}
+		if (OutLayout.NumMemories > 1)
+		{
+			OutErrorString = TEXT("Modules with multiple memories aren't supported.");
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Copies Binary section by section. Sections with an entry in Replacements get its payload instead, or are dropped if it's unset.
+	 * Replacements for sections Binary doesn't have are inserted in section order.
+	 */
+	static void EmitWasmModule(const TArray<uint8>& Binary, const FWasmModuleLayout& Layout,
+	                           const TSortedMap<uint8, TOptional<TArray<uint8>>>& Replacements, TArray<uint8>& OutBinary)
+	{
+		OutBinary.Reset();
+		FWasmBinaryWriter Writer(OutBinary);
+		Writer.WriteBytes(Binary.GetData(), WasmHeaderSize);
+
+		TSet<uint8> Inserted;
+		const auto InsertMissingSections = [&](int32 BeforeRank)
+		{
+			TArray<TPair<int32, uint8>> Missing;
+			for (const auto& Replacement : Replacements)
+			{
+				if (Replacement.Value.IsSet() && !Layout.FindSection(Replacement.Key) && !Inserted.Contains(Replacement.Key) &&
+					GetSectionRank(Replacement.Key) < BeforeRank)
+				{
+					Missing.Emplace(GetSectionRank(Replacement.Key), Replacement.Key);
+				}
+			}
+			Missing.Sort([](const TPair<int32, uint8>& A, const TPair<int32, uint8>& B) { return A.Key < B.Key; });
+			for (const TPair<int32, uint8>& Section : Missing)
+			{
+				Writer.WriteSection(Section.Value, Replacements.FindChecked(Section.Value).GetValue());
+				Inserted.Add(Section.Value);
+			}
+		};
+
+		for (const FWasmSectionRange& Section : Layout.Sections)
+		{
+			if (Section.Id == WasmSectionCustom)
+			{
+				Writer.WriteBytes(Binary.GetData() + Section.Start, Section.PayloadOffset + Section.PayloadSize - Section.Start);
+				continue;
+			}
+
+			InsertMissingSections(GetSectionRank(Section.Id));
+			if (const TOptional<TArray<uint8>>* Replacement = Replacements.Find(Section.Id))
+			{
+				if (Replacement->IsSet())
+				{
+					Writer.WriteSection(Section.Id, Replacement->GetValue());
+				}
+			}
+			else
+			{
+				Writer.WriteBytes(Binary.GetData() + Section.Start, Section.PayloadOffset + Section.PayloadSize - Section.Start);
+			}
+		}
+		InsertMissingSections(MAX_int32);
+	}
+
+	/**
+	 * Rewrites the export section, dropping the exports named in Removed and appending Added as (name, kind, index).
+	 */
+	static TArray<uint8> MakeExportSection(const TArray<uint8>& Binary, const FWasmModuleLayout& Layout, const TSet<FString>& Removed,
+	                                       const TArray<TTuple<FString, uint8, uint32>>& Added)
+	{
+		TArray<uint8> Entries;
+		FWasmBinaryWriter EntryWriter(Entries);
+		uint64 NumEntries = 0;
+
+		if (const FWasmSectionRange* Section = Layout.FindSection(WasmSectionExport))
+		{
+			FWasmBinaryReader Reader(Binary.GetData(), Section->PayloadOffset + Section->PayloadSize, Section->PayloadOffset);
+			const uint64 NumExports = Reader.ReadVarUInt();
+			for (uint64 Index = 0; Index < NumExports && !Reader.bError; Index++)
+			{
+				const int64 EntryStart = Reader.Offset;
+				const FString& Name = Reader.ReadName();
+				Reader.ReadByte();
+				Reader.ReadVarUInt();
+				if (!Removed.Contains(Name))
+				{
+					EntryWriter.WriteBytes(Binary.GetData() + EntryStart, Reader.Offset - EntryStart);
+					NumEntries++;
+				}
+			}
+		}
+
+		for (const TTuple<FString, uint8, uint32>& Export : Added)
+		{
+			EntryWriter.WriteName(Export.Get<0>());
+			EntryWriter.WriteByte(Export.Get<1>());
+			EntryWriter.WriteVarUInt(Export.Get<2>());
+			NumEntries++;
+		}
+
+		TArray<uint8> Payload;
+		FWasmBinaryWriter Writer(Payload);
+		Writer.WriteVarUInt(NumEntries);
+		Payload.Append(Entries);
+		return Payload;
+	}
+
+	static bool WriteConstExpr(FWasmBinaryWriter& Writer, uint8 ValType, const wasm_val_t& Value)
+	{
+		switch (ValType)
+		{
+		case WasmTypeI32:
+			Writer.WriteByte(WasmOpI32Const);
+			Writer.WriteVarInt(Value.of.i32);
+			break;
+		case WasmTypeI64:
+			Writer.WriteByte(WasmOpI64Const);
+			Writer.WriteVarInt(Value.of.i64);
+			break;
+		case WasmTypeF32:
+			Writer.WriteByte(WasmOpF32Const);
+			Writer.WriteBytes(reinterpret_cast<const uint8*>(&Value.of.f32), sizeof(float));
+			break;
+		case WasmTypeF64:
+			Writer.WriteByte(WasmOpF64Const);
+			Writer.WriteBytes(reinterpret_cast<const uint8*>(&Value.of.f64), sizeof(double));
+			break;
+		default:
+			return false;
+		}
+		Writer.WriteByte(WasmOpEnd);
+		return true;
+	}
+
+	static TArray<uint8> MakeDataSection(const uint8* Memory, uint64 MemorySize, uint32& OutNumSegments)
+	{
+		TArray<uint8> Segments;
+		FWasmBinaryWriter Writer(Segments);
+		OutNumSegments = 0;
+
+		// Memory starts out zeroed, only the non zero runs need segments.
+		uint64 Offset = 0;
+		while (Offset < MemorySize)
+		{
+			while (Offset < MemorySize && Memory[Offset] == 0)
+			{
+				Offset++;
+			}
+			if (Offset >= MemorySize)
+			{
+				break;
+			}
+
+			const uint64 Start = Offset;
+			uint64 End = Offset;
+			uint64 ZeroRun = 0;
+			for (; Offset < MemorySize; Offset++)
+			{
+				if (Memory[Offset] != 0)
+				{
+					End = Offset + 1;
+					ZeroRun = 0;
+				}
+				else if (++ZeroRun >= MinDataSegmentGap)
+				{
+					break;
+				}
+			}
+
+			Writer.WriteVarUInt(0);
+			Writer.WriteByte(WasmOpI32Const);
+			Writer.WriteVarInt(static_cast<int32>(Start));
+			Writer.WriteByte(WasmOpEnd);
+			Writer.WriteVarUInt(End - Start);
+			Writer.WriteBytes(Memory + Start, End - Start);
+			OutNumSegments++;
+		}
+
+		TArray<uint8> Payload;
+		FWasmBinaryWriter PayloadWriter(Payload);
+		PayloadWriter.WriteVarUInt(OutNumSegments);
+		Payload.Append(Segments);
+		return Payload;
+	}
+
+	static bool CallInitExport(const TWasmExecutionContext& Context, const FString& ExportName, FString& OutErrorString)
+	{
+		wasm_extern_t* Extern = Context.FindExport(*ExportName);
+		wasm_func_t* Func = Extern ? wasm_extern_as_func(Extern) : nullptr;
+		if (!Func || !WasmFuncTypeMatches(Func, nullptr, 0, nullptr, 0))
+		{
+			OutErrorString = FString::Printf(TEXT("%s isn't an exported function without parameters and results."), *ExportName);
+			return false;
+		}
+
+		const wasm_val_vec_t Args = wasm_val_vec_t{0, nullptr};
+		wasm_val_vec_t Results = wasm_val_vec_t{0, nullptr};
+		wasm_trap_t* Trap = nullptr;
+		wasmtime_error_t* Error = wasmtime_func_call(Func, &Args, &Results, &Trap);
+		return HandleErrorWithOut(OutErrorString, [&ExportName]()
+		{
+			return FString::Printf(TEXT("Pre-initialize (%s)"), *ExportName);
+		}, Error, Trap);
+	}
+
+	bool WasmPreInitialize(const TWasmEngine& Engine, const TArray<uint8>& Binary, const TWasmPreInitOptions& Options,
+	                       TArray<uint8>& OutBinary, FString& OutErrorString)
+	{
+		check(Engine.Get());
+
+		FWasmModuleLayout Layout;
+		if (!ParseWasmModule(Binary, Layout, OutErrorString))
+		{
+			return false;
+		}
+
+		// Export the memory and every mutable global so their values can be read after initialization.
+		TArray<TTuple<FString, uint8, uint32>> InstrumentExports;
+		if (Layout.NumMemories > 0)
+		{
+			InstrumentExports.Emplace(PreInitMemoryExport, WasmExternMemory, 0);
+		}
+		for (int32 Index = 0; Index < Layout.Globals.Num(); Index++)
+		{
+			const FWasmGlobalDesc& Global = Layout.Globals[Index];
+			if (!Global.bMutable)
+			{
+				continue;
+			}
+			if (Global.ValType != WasmTypeI32 && Global.ValType != WasmTypeI64 && Global.ValType != WasmTypeF32 && Global.ValType != WasmTypeF64)
+			{
+				OutErrorString = FString::Printf(TEXT("Mutable global %i isn't numeric, its value can't be captured."), Index);
+				return false;
+			}
+			InstrumentExports.Emplace(PreInitGlobalExport + FString::FromInt(Index), WasmExternGlobal, Layout.NumImportedGlobals + Index);
+		}
+
+		TSortedMap<uint8, TOptional<TArray<uint8>>> Replacements;
+		Replacements.Add(WasmSectionExport, MakeExportSection(Binary, Layout, {}, InstrumentExports));
+
+		TArray<uint8> Instrumented;
+		EmitWasmModule(Binary, Layout, Replacements, Instrumented);
+
+		const TWasmByteVec& InstrumentedVec = MakeWasmVec<TWasmByteVec>(reinterpret_cast<wasm_byte_t*>(Instrumented.GetData()), Instrumented.Num());
+		const TWasmModule& Module = MakeWasmModule(Engine, InstrumentedVec, OutErrorString);
+		if (!Module.IsValid())
+		{
+			return false;
+		}
+
+		const FString& WorkspacePath = Options.WorkspacePath.IsEmpty() ? FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir()) : Options.WorkspacePath;
+		TWasmExecutionContext Context(Module, Engine, Options.HostFunctions, GenerateWasmImportMap(Module), GenerateWasmExternMap(Module),
+		                              WorkspacePath);
+		if (!Context.IsValid())
+		{
+			OutErrorString = Context.Error.IsEmpty() ? FString(TEXT("Failed to instantiate the module.")) : Context.Error;
+			return false;
+		}
+
+		TSet<FString> InitExports = {Options.InitExport};
+		if (Options.InitExport != ReactorInitExport && Context.FindExport(ReactorInitExport))
+		{
+			if (!CallInitExport(Context, ReactorInitExport, OutErrorString))
+			{
+				return false;
+			}
+			InitExports.Add(ReactorInitExport);
+		}
+		if (!CallInitExport(Context, Options.InitExport, OutErrorString))
+		{
+			return false;
+		}
+
+		// Globals get their current values as initializers, immutable ones keep theirs.
+		TArray<uint8> GlobalSection;
+		FWasmBinaryWriter GlobalWriter(GlobalSection);
+		GlobalWriter.WriteVarUInt(Layout.Globals.Num());
+		for (int32 Index = 0; Index < Layout.Globals.Num(); Index++)
+		{
+			const FWasmGlobalDesc& Global = Layout.Globals[Index];
+			GlobalWriter.WriteByte(Global.ValType);
+			GlobalWriter.WriteByte(Global.bMutable ? 1 : 0);
+			if (!Global.bMutable)
+			{
+				GlobalWriter.WriteBytes(Binary.GetData() + Global.InitExprOffset, Global.InitExprSize);
+				continue;
+			}
+
+			wasm_extern_t* Extern = Context.FindExport(*(PreInitGlobalExport + FString::FromInt(Index)));
+			wasm_global_t* GlobalInstance = Extern ? wasm_extern_as_global(Extern) : nullptr;
+			check(GlobalInstance);
+
+			wasm_val_t Value;
+			wasm_global_get(GlobalInstance, &Value);
+			verify(WriteConstExpr(GlobalWriter, Global.ValType, Value));
+		}
+
+		Replacements.Reset();
+		if (Layout.Globals.Num() > 0)
+		{
+			Replacements.Add(WasmSectionGlobal, MoveTemp(GlobalSection));
+		}
+
+		const TSet<FString>& RemovedExports = Options.bKeepInitExport ? TSet<FString>() : InitExports;
+		Replacements.Add(WasmSectionExport, MakeExportSection(Binary, Layout, RemovedExports, {}));
+		Replacements.Add(WasmSectionStart, TOptional<TArray<uint8>>());
+
+		uint32 NumSegments = 0;
+		uint64 MemorySize = 0;
+		if (Layout.NumMemories > 0)
+		{
+			wasm_extern_t* Extern = Context.FindExport(PreInitMemoryExport);
+			wasm_memory_t* Memory = Extern ? wasm_extern_as_memory(Extern) : nullptr;
+			check(Memory);
+
+			// The memory keeps whatever the init export grew it to.
+			MemorySize = wasm_memory_data_size(Memory);
+			TArray<uint8> MemorySection;
+			FWasmBinaryWriter MemoryWriter(MemorySection);
+			MemoryWriter.WriteVarUInt(1);
+			MemoryWriter.WriteByte(Layout.MemoryFlags);
+			MemoryWriter.WriteVarUInt(FMath::Max<uint64>(Layout.MemoryMinPages, MemorySize / WasmPageSize));
+			if (Layout.MemoryFlags & 1)
+			{
+				MemoryWriter.WriteVarUInt(Layout.MemoryMaxPages);
+			}
+			Replacements.Add(WasmSectionMemory, MoveTemp(MemorySection));
+			Replacements.Add(WasmSectionData, MakeDataSection(reinterpret_cast<const uint8*>(wasm_memory_data(Memory)), MemorySize, NumSegments));
+		}
+		else if (Layout.FindSection(WasmSectionData))
+		{
+			Replacements.Add(WasmSectionData, TOptional<TArray<uint8>>());
+		}
+
+		if (Layout.FindSection(WasmSectionDataCount))
+		{
+			TArray<uint8> DataCountSection;
+			FWasmBinaryWriter DataCountWriter(DataCountSection);
+			DataCountWriter.WriteVarUInt(NumSegments);
+			Replacements.Add(WasmSectionDataCount, MoveTemp(DataCountSection));
+		}
+
+		EmitWasmModule(Binary, Layout, Replacements, OutBinary);
+
+		const TWasmStore& Store = MakeWasmStore(Engine);
+		const TWasmByteVec& OutVec = MakeWasmVec<TWasmByteVec>(reinterpret_cast<wasm_byte_t*>(OutBinary.GetData()), OutBinary.Num());
+		if (!WasmModuleValidate(Store, OutVec, OutErrorString))
+		{
+			OutBinary.Reset();
+			return false;
+		}
+
+		UE_LOG(LogUEWasmTime, Log, TEXT("Pre-initialized module: %llu bytes of memory in %u data segments, %i globals, %i -> %i bytes."),
+		       MemorySize, NumSegments, Layout.Globals.Num(), Binary.Num(), OutBinary.Num());
+		return true;
+	}
+}
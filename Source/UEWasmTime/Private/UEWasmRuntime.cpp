@@ -0,0 +1,261 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmRuntime.h"
+#include "Containers/Queue.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "UEWasmModuleRegistry.h"
+
+DECLARE_CYCLE_STAT(TEXT("Runtime Task"), STAT_WasmRuntimeTask, STATGROUP_UEWasmTime);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Runtime Queued Tasks"), STAT_WasmRuntimeQueuedTasks, STATGROUP_UEWasmTime);
+
+namespace UEWas
+{
+	class FWasmRuntimeWorker : public FRunnable
+	{
+	public:
+		FWasmRuntimeWorker(const FString& Name, EThreadPriority Priority)
+			: NumContexts(0), WakeEvent(FPlatformProcess::GetSynchEventFromPool(false)), bStopping(false), NumQueued(0)
+		{
+			Thread = FRunnableThread::Create(this, *Name, 0, Priority);
+			check(Thread);
+		}
+
+		virtual ~FWasmRuntimeWorker() override
+		{
+			bStopping = true;
+			WakeEvent->Trigger();
+			Thread->WaitForCompletion();
+			delete Thread;
+			FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		}
+
+		virtual uint32 Run() override
+		{
+			while (!bStopping)
+			{
+				RunQueuedTasks();
+				WakeEvent->Wait();
+			}
+
+			// Tasks queued before shutdown still complete their promises, contexts die on the thread that owns them.
+			RunQueuedTasks();
+			Contexts.Empty();
+			return 0;
+		}
+
+		void Enqueue(TUniqueFunction<void()>&& Task)
+		{
+			NumQueued++;
+			INC_DWORD_STAT(STAT_WasmRuntimeQueuedTasks);
+			Tasks.Enqueue(MoveTemp(Task));
+			WakeEvent->Trigger();
+		}
+
+		FORCEINLINE uint32 GetThreadId() const
+		{
+			return Thread->GetThreadID();
+		}
+
+		/** Only touched on the worker thread. */
+		TMap<uint32, TWasmExecutionContextPtr> Contexts;
+		std::atomic<int32> NumContexts;
+
+		FORCEINLINE int32 GetLoad() const
+		{
+			return NumContexts + NumQueued;
+		}
+
+	protected:
+		void RunQueuedTasks()
+		{
+			TUniqueFunction<void()> Task;
+			while (Tasks.Dequeue(Task))
+			{
+				{
+					SCOPE_CYCLE_COUNTER(STAT_WasmRuntimeTask);
+					Task();
+				}
+				Task = nullptr;
+				NumQueued--;
+				DEC_DWORD_STAT(STAT_WasmRuntimeQueuedTasks);
+			}
+		}
+
+		TQueue<TUniqueFunction<void()>, EQueueMode::Mpsc> Tasks;
+		FEvent* WakeEvent;
+		FRunnableThread* Thread = nullptr;
+		std::atomic<bool> bStopping;
+		std::atomic<int32> NumQueued;
+	};
+
+	FWasmRuntime::FWasmRuntime(int32 NumWorkers, const FString& Name, EThreadPriority Priority)
+		: NextContextId(0)
+	{
+		if (NumWorkers <= 0)
+		{
+			NumWorkers = FMath::Max(FPlatformMisc::NumberOfWorkerThreadsToSpawn(), 1);
+		}
+
+		for (int32 Index = 0; Index < NumWorkers; Index++)
+		{
+			Workers.Add(MakeUnique<FWasmRuntimeWorker>(FString::Printf(TEXT("%s %i"), *Name, Index), Priority));
+		}
+	}
+
+	FWasmRuntime::~FWasmRuntime()
+	{
+		Workers.Empty();
+	}
+
+	TFuture<FWasmRuntimeContextHandle> FWasmRuntime::CreateContext(const TWasmModuleHandle& Module, const FWasmEngineProfilePtr& EngineProfile,
+	                                                               const TArray<TWasmFunctionSignaturePtr>& HostFunctions,
+	                                                               const FString& WorkspacePath, int32 Worker)
+	{
+		check(Module.IsValid());
+		check(EngineProfile.IsValid());
+
+		const int32 WorkerIndex = Workers.IsValidIndex(Worker) ? Worker : PickWorker();
+		const uint32 Id = ++NextContextId;
+		FWasmRuntimeWorker& Owner = *Workers[WorkerIndex];
+		Owner.NumContexts++;
+
+		TPromise<FWasmRuntimeContextHandle> Promise;
+		TFuture<FWasmRuntimeContextHandle> Future = Promise.GetFuture();
+		Owner.Enqueue([&Owner, WorkerIndex, Id, Module, EngineProfile, HostFunctions, WorkspacePath, Promise = MoveTemp(Promise)]() mutable
+		{
+			TWasmExecutionContextPtr Context = MakeUnique<TWasmExecutionContext>(Module, EngineProfile->Engine, HostFunctions, WorkspacePath);
+			if (!Context->IsValid())
+			{
+				UE_LOG(LogUEWasmTime, Error, TEXT("Runtime failed to instantiate module %s: %s"), *Module->Key, *Context->Error);
+				Owner.NumContexts--;
+				Promise.SetValue({});
+				return;
+			}
+
+			Owner.Contexts.Add(Id, MoveTemp(Context));
+			Promise.SetValue({WorkerIndex, Id});
+		});
+		return Future;
+	}
+
+	TFuture<FWasmRuntimeContextHandle> FWasmRuntime::AddContext(TWasmExecutionContextPtr&& Context, int32 Worker)
+	{
+		TPromise<FWasmRuntimeContextHandle> Promise;
+		TFuture<FWasmRuntimeContextHandle> Future = Promise.GetFuture();
+		if (!Context.IsValid() || !Context->IsValid())
+		{
+			Promise.SetValue({});
+			return Future;
+		}
+
+		const int32 WorkerIndex = Workers.IsValidIndex(Worker) ? Worker : PickWorker();
+		const uint32 Id = ++NextContextId;
+		FWasmRuntimeWorker& Owner = *Workers[WorkerIndex];
+		Owner.NumContexts++;
+		Owner.Enqueue([&Owner, WorkerIndex, Id, Context = MoveTemp(Context), Promise = MoveTemp(Promise)]() mutable
+		{
+			Owner.Contexts.Add(Id, MoveTemp(Context));
+			Promise.SetValue({WorkerIndex, Id});
+		});
+		return Future;
+	}
+
+	TFuture<bool> FWasmRuntime::DestroyContext(const FWasmRuntimeContextHandle& Handle)
+	{
+		TPromise<bool> Promise;
+		TFuture<bool> Future = Promise.GetFuture();
+		if (!Workers.IsValidIndex(Handle.Worker))
+		{
+			Promise.SetValue(false);
+			return Future;
+		}
+
+		FWasmRuntimeWorker& Owner = *Workers[Handle.Worker];
+		Owner.Enqueue([&Owner, Id = Handle.Id, Promise = MoveTemp(Promise)]() mutable
+		{
+			const bool bRemoved = Owner.Contexts.Remove(Id) > 0;
+			if (bRemoved)
+			{
+				Owner.NumContexts--;
+			}
+			Promise.SetValue(bRemoved);
+		});
+		return Future;
+	}
+
+	TFuture<FWasmRuntimeCallResult> FWasmRuntime::Call(const FWasmRuntimeContextHandle& Handle, const FName& ExportName, TArray<wasm_val_t> Args)
+	{
+		return Execute(Handle, [ExportName, Args = MoveTemp(Args)](TWasmExecutionContext& Context) mutable
+		{
+			FWasmRuntimeCallResult Result;
+			wasm_extern_t* Extern = Context.FindExport(ExportName);
+			wasm_func_t* Func = Extern ? wasm_extern_as_func(Extern) : nullptr;
+			if (!Func)
+			{
+				Result.Error = FString::Printf(TEXT("No exported function %s."), *ExportName.ToString());
+				return Result;
+			}
+
+			Result.Results.SetNumZeroed(wasm_func_result_arity(Func));
+			const wasm_val_vec_t ArgsVec = wasm_val_vec_t{static_cast<size_t>(Args.Num()), Args.GetData()};
+			wasm_val_vec_t ResultsVec = wasm_val_vec_t{static_cast<size_t>(Result.Results.Num()), Result.Results.GetData()};
+			wasm_trap_t* Trap = nullptr;
+			wasmtime_error_t* CallError = wasmtime_func_call(Func, &ArgsVec, &ResultsVec, &Trap);
+			Result.bSuccess = HandleErrorWithOut(Result.Error, [&ExportName]()
+			{
+				return FString::Printf(TEXT("Runtime Call (%s)"), *ExportName.ToString());
+			}, CallError, Trap, false);
+			return Result;
+		});
+	}
+
+	void FWasmRuntime::EnqueueTask(int32 Worker, TUniqueFunction<void()>&& Task)
+	{
+		check(Workers.IsValidIndex(Worker));
+		Workers[Worker]->Enqueue(MoveTemp(Task));
+	}
+
+	int32 FWasmRuntime::GetCurrentWorker() const
+	{
+		const uint32 ThreadId = FPlatformTLS::GetCurrentThreadId();
+		return Workers.IndexOfByPredicate([ThreadId](const TUniquePtr<FWasmRuntimeWorker>& Worker)
+		{
+			return Worker->GetThreadId() == ThreadId;
+		});
+	}
+
+	void FWasmRuntime::EnqueueContextTask(const FWasmRuntimeContextHandle& Handle, TUniqueFunction<void(TWasmExecutionContext*)>&& Task)
+	{
+		if (!Workers.IsValidIndex(Handle.Worker))
+		{
+			Task(nullptr);
+			return;
+		}
+
+		FWasmRuntimeWorker& Owner = *Workers[Handle.Worker];
+		Owner.Enqueue([&Owner, Id = Handle.Id, Task = MoveTemp(Task)]() mutable
+		{
+			const TWasmExecutionContextPtr* Context = Owner.Contexts.Find(Id);
+			Task(Context ? Context->Get() : nullptr);
+		});
+	}
+
+	int32 FWasmRuntime::PickWorker() const
+	{
+		int32 BestWorker = 0;
+		int32 BestLoad = MAX_int32;
+		for (int32 Index = 0; Index < Workers.Num(); Index++)
+		{
+			const int32 Load = Workers[Index]->GetLoad();
+			if (Load < BestLoad)
+			{
+				BestLoad = Load;
+				BestWorker = Index;
+			}
+		}
+		return BestWorker;
+	}
+}
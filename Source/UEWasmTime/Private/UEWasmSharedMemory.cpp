@@ -0,0 +1,65 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmSharedMemory.h"
+#include "UEWasmModuleRegistry.h"
+
+namespace UEWas
+{
+	TWasmSharedMemoryGroup::TWasmSharedMemoryGroup(const TWasmEngine& InEngine, const TWasmSharedMemorySettings& InSettings)
+		: Settings(InSettings)
+	{
+		Store = MakeWasmStore(InEngine);
+		ImportModule = MakeWasmName(Settings.ImportModule);
+		ImportName = MakeWasmName(Settings.ImportName);
+
+		const wasm_limits_t Limits = {Settings.MinimumPages, Settings.MaximumPages > 0 ? Settings.MaximumPages : wasm_limits_max_default};
+		const TWasmMemoryType MemoryType = TWasmMemoryType(wasm_memorytype_new(&Limits));
+		Memory = TWasmMemory(wasm_memory_new(Store.Get(), MemoryType.Get()));
+		if (!Memory.IsValid())
+		{
+			Error = FString::Printf(TEXT("Failed to create a shared memory of %u to %u pages."), Limits.min, Limits.max);
+			UE_LOG(LogUEWasmTime, Error, TEXT("%s"), *Error);
+		}
+	}
+
+	TSharedRef<TWasmSharedMemoryGroup, ESPMode::ThreadSafe> TWasmSharedMemoryGroup::Create(const TWasmEngine& InEngine,
+	                                                                                       const TWasmSharedMemorySettings& InSettings)
+	{
+		return MakeShared<TWasmSharedMemoryGroup, ESPMode::ThreadSafe>(InEngine, InSettings);
+	}
+
+	TWasmExecutionContextPtr TWasmSharedMemoryGroup::CreateContext(const TWasmModuleHandle& Module,
+	                                                               const TArray<TWasmFunctionSignaturePtr>& HostFunctions,
+	                                                               const FString& WorkspacePath)
+	{
+		if (!IsValid())
+		{
+			return {};
+		}
+
+		TWasmExecutionContextPtr Context = MakeUnique<TWasmExecutionContext>(Module, AsShared(), HostFunctions, WorkspacePath);
+		if (!Context->IsValid())
+		{
+			UE_LOG(LogUEWasmTime, Error, TEXT("Failed to instantiate module %s into a shared memory group: %s"), *Module->Key, *Context->Error);
+			return {};
+		}
+		return Context;
+	}
+
+	bool TWasmSharedMemoryGroup::DefineMemory(const TWasmLinker& Linker, FString& OutError) const
+	{
+		check(Linker.Get());
+		if (!IsValid())
+		{
+			OutError = Error;
+			return false;
+		}
+
+		wasmtime_error_t* LinkError = wasmtime_linker_define(Linker.Get(), &ImportModule.Get()->Value, &ImportName.Get()->Value,
+		                                                     wasm_memory_as_extern(Memory.Get()));
+		return HandleErrorWithOut(OutError, [this]()
+		{
+			return FString::Printf(TEXT("Define shared memory %s.%s"), *Settings.ImportModule, *Settings.ImportName);
+		}, LinkError);
+	}
+}
@@ -0,0 +1,279 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmString.h"
+#include "Misc/ByteSwap.h"
+#include "UEWasmMemoryView.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#define UEWASM_STRING_SSE2 1
+#else
+#define UEWASM_STRING_SSE2 0
+#endif
+
+namespace UEWas
+{
+	/**
+	 * Number of leading bytes below 0x80.
+	 */
+	static SIZE_T WasmCountAsciiPrefix(const uint8* Data, SIZE_T NumBytes)
+	{
+		SIZE_T Index = 0;
+#if UEWASM_STRING_SSE2
+		for (; Index + 16 <= NumBytes; Index += 16)
+		{
+			const __m128i Chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + Index));
+			const int32 HighBits = _mm_movemask_epi8(Chunk);
+			if (HighBits != 0)
+			{
+				return Index + FMath::CountTrailingZeros(static_cast<uint32>(HighBits));
+			}
+		}
+#endif
+		while (Index < NumBytes && Data[Index] < 0x80)
+		{
+			Index++;
+		}
+		return Index;
+	}
+
+	/**
+	 * Number of leading characters below 0x80.
+	 */
+	static int32 WasmCountAsciiPrefix(const TCHAR* Chars, int32 NumChars)
+	{
+		int32 Index = 0;
+#if UEWASM_STRING_SSE2
+		if constexpr (sizeof(TCHAR) == 2)
+		{
+			const __m128i NonAsciiMask = _mm_set1_epi16(static_cast<int16>(0xFF80));
+			const __m128i Zero = _mm_setzero_si128();
+			for (; Index + 8 <= NumChars; Index += 8)
+			{
+				const __m128i Chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Chars + Index));
+				const __m128i NonAscii = _mm_and_si128(Chunk, NonAsciiMask);
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(NonAscii, Zero)) != 0xFFFF)
+				{
+					break;
+				}
+			}
+		}
+#endif
+		while (Index < NumChars && static_cast<uint32>(Chars[Index]) < 0x80)
+		{
+			Index++;
+		}
+		return Index;
+	}
+
+	static void WasmWidenAscii(const uint8* Data, SIZE_T NumBytes, TCHAR* Out)
+	{
+		SIZE_T Index = 0;
+#if UEWASM_STRING_SSE2
+		if constexpr (sizeof(TCHAR) == 2)
+		{
+			const __m128i Zero = _mm_setzero_si128();
+			for (; Index + 16 <= NumBytes; Index += 16)
+			{
+				const __m128i Chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + Index));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + Index), _mm_unpacklo_epi8(Chunk, Zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + Index + 8), _mm_unpackhi_epi8(Chunk, Zero));
+			}
+		}
+#endif
+		for (; Index < NumBytes; Index++)
+		{
+			Out[Index] = static_cast<TCHAR>(Data[Index]);
+		}
+	}
+
+	static void WasmNarrowAscii(const TCHAR* Chars, int32 NumChars, uint8* Out)
+	{
+		int32 Index = 0;
+#if UEWASM_STRING_SSE2
+		if constexpr (sizeof(TCHAR) == 2)
+		{
+			for (; Index + 16 <= NumChars; Index += 16)
+			{
+				const __m128i Low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Chars + Index));
+				const __m128i High = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Chars + Index + 8));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + Index), _mm_packus_epi16(Low, High));
+			}
+		}
+#endif
+		for (; Index < NumChars; Index++)
+		{
+			Out[Index] = static_cast<uint8>(Chars[Index]);
+		}
+	}
+
+	SIZE_T WasmFindNul(const uint8* Data, SIZE_T NumBytes)
+	{
+		SIZE_T Index = 0;
+#if UEWASM_STRING_SSE2
+		const __m128i Zero = _mm_setzero_si128();
+		for (; Index + 16 <= NumBytes; Index += 16)
+		{
+			const __m128i Chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + Index));
+			const int32 NulBits = _mm_movemask_epi8(_mm_cmpeq_epi8(Chunk, Zero));
+			if (NulBits != 0)
+			{
+				return Index + FMath::CountTrailingZeros(static_cast<uint32>(NulBits));
+			}
+		}
+#endif
+		while (Index < NumBytes && Data[Index] != 0)
+		{
+			Index++;
+		}
+		return Index;
+	}
+
+	FString WasmDecodeUtf8(const uint8* Data, SIZE_T NumBytes)
+	{
+		if (!Data || NumBytes == 0)
+		{
+			return FString();
+		}
+
+		checkf(NumBytes <= MAX_int32, TEXT("Wasm string of %llu bytes is too long."), static_cast<uint64>(NumBytes));
+
+		const SIZE_T NumAscii = WasmCountAsciiPrefix(Data, NumBytes);
+		if (NumAscii == NumBytes)
+		{
+			FString Out;
+			TArray<TCHAR>& Chars = Out.GetCharArray();
+			Chars.SetNumUninitialized(NumBytes + 1);
+			WasmWidenAscii(Data, NumBytes, Chars.GetData());
+			Chars[NumBytes] = TEXT('\0');
+			return Out;
+		}
+
+		// Everything past the first multi-byte sequence goes through the engine decoder, it handles invalid input.
+		const FUTF8ToTCHAR Tail(reinterpret_cast<const ANSICHAR*>(Data + NumAscii), static_cast<int32>(NumBytes - NumAscii));
+		FString Out;
+		TArray<TCHAR>& Chars = Out.GetCharArray();
+		Chars.SetNumUninitialized(NumAscii + Tail.Length() + 1);
+		WasmWidenAscii(Data, NumAscii, Chars.GetData());
+		FMemory::Memcpy(Chars.GetData() + NumAscii, Tail.Get(), Tail.Length() * sizeof(TCHAR));
+		Chars[NumAscii + Tail.Length()] = TEXT('\0');
+		return Out;
+	}
+
+	SIZE_T WasmUtf8Length(const TCHAR* Chars, int32 NumChars)
+	{
+		const int32 NumAscii = WasmCountAsciiPrefix(Chars, NumChars);
+		if (NumAscii == NumChars)
+		{
+			return NumChars;
+		}
+		return NumAscii + FPlatformString::ConvertedLength<UTF8CHAR>(Chars + NumAscii, NumChars - NumAscii);
+	}
+
+	SIZE_T WasmEncodeUtf8(const TCHAR* Chars, int32 NumChars, uint8* Out, SIZE_T OutCapacity)
+	{
+		const int32 NumAscii = WasmCountAsciiPrefix(Chars, NumChars);
+		check(OutCapacity >= static_cast<SIZE_T>(NumAscii));
+		WasmNarrowAscii(Chars, NumAscii, Out);
+		if (NumAscii == NumChars)
+		{
+			return NumAscii;
+		}
+
+		UTF8CHAR* Dest = reinterpret_cast<UTF8CHAR*>(Out + NumAscii);
+		UTF8CHAR* End = FPlatformString::Convert(Dest, static_cast<int32>(FMath::Min<SIZE_T>(OutCapacity - NumAscii, MAX_int32)), Chars + NumAscii,
+		                                         NumChars - NumAscii);
+		checkf(End, TEXT("UTF-8 output buffer is too small."));
+		return NumAscii + (End - Dest);
+	}
+
+	FString WasmReadUtf8String(const uint8* Memory, uint64 MemorySize, uint64 Offset, uint64 MaxBytes)
+	{
+		if (!Memory || Offset >= MemorySize)
+		{
+			return FString();
+		}
+		const uint8* Data = Memory + Offset;
+		return WasmDecodeUtf8(Data, WasmFindNul(Data, FMath::Min(MaxBytes, MemorySize - Offset)));
+	}
+
+	FString WasmMemoryReadString(const TWasmExecutionContext& Context, uint64 Offset, uint64 MaxBytes)
+	{
+		Context.GetMemoryEpoch();
+		return WasmReadUtf8String(Context.GetCachedMemoryData(), Context.GetCachedMemorySize(), Offset, MaxBytes);
+	}
+
+	FString WasmMemoryReadStringWithLength(const TWasmExecutionContext& Context, uint64 Offset, uint64 NumBytes)
+	{
+		const TWasmByteView View = MakeWasmMemoryView<uint8>(Context, Offset, NumBytes);
+		return View.IsValid() ? WasmDecodeUtf8(View.GetData(), NumBytes) : FString();
+	}
+
+	FString WasmMemoryReadLengthPrefixedString(const TWasmExecutionContext& Context, uint64 Offset)
+	{
+		const TWasmMemoryView<uint32> Length = MakeWasmMemoryView<uint32>(Context, Offset, 1);
+		return Length.IsValid() ? WasmMemoryReadStringWithLength(Context, Offset + sizeof(uint32), INTEL_ORDER32(Length.Read(0))) : FString();
+	}
+
+	int64 WasmMemoryWriteStringAt(const TWasmExecutionContext& Context, uint64 Offset, uint64 Capacity, const FString& String,
+	                              bool bNullTerminate)
+	{
+		const SIZE_T NumBytes = WasmUtf8Length(*String, String.Len());
+		const uint64 Size = NumBytes + (bNullTerminate ? 1 : 0);
+		const TWasmByteView View = MakeWasmMemoryView<uint8>(Context, Offset, Size);
+		if (Size > Capacity || !View.IsValid())
+		{
+			return INDEX_NONE;
+		}
+
+		WasmEncodeUtf8(*String, String.Len(), View.GetData(), NumBytes);
+		if (bNullTerminate)
+		{
+			View.Write(NumBytes, 0);
+		}
+		return Size;
+	}
+
+	uint32 WasmMemoryWriteString(const TWasmExecutionContext& Context, const TWasmAllocFunc& Alloc, const FString& String, bool bNullTerminate)
+	{
+		const uint64 Size = WasmUtf8Length(*String, String.Len()) + (bNullTerminate ? 1 : 0);
+		int32 Pointer = 0;
+		if (!Alloc.Call(static_cast<int32>(Size), Pointer) || Pointer == 0)
+		{
+			return 0;
+		}
+
+		// The allocation may have grown the memory, the write resolves it again.
+		return WasmMemoryWriteStringAt(Context, static_cast<uint32>(Pointer), Size, String, bNullTerminate) != INDEX_NONE
+			       ? static_cast<uint32>(Pointer)
+			       : 0;
+	}
+
+	int64 WasmMemoryWriteLengthPrefixedStringAt(const TWasmExecutionContext& Context, uint64 Offset, uint64 Capacity, const FString& String)
+	{
+		const SIZE_T NumBytes = WasmUtf8Length(*String, String.Len());
+		const uint64 Size = sizeof(uint32) + NumBytes;
+		const TWasmByteView View = MakeWasmMemoryView<uint8>(Context, Offset, Size);
+		if (Size > Capacity || NumBytes > MAX_uint32 || !View.IsValid())
+		{
+			return INDEX_NONE;
+		}
+
+		View.Slice<uint32>(0, 1).Write(0, INTEL_ORDER32(static_cast<uint32>(NumBytes)));
+		WasmEncodeUtf8(*String, String.Len(), View.GetData() + sizeof(uint32), NumBytes);
+		return Size;
+	}
+
+	uint32 WasmMemoryWriteLengthPrefixedString(const TWasmExecutionContext& Context, const TWasmAllocFunc& Alloc, const FString& String)
+	{
+		const uint64 Size = WasmLengthPrefixedStringSize(String);
+		int32 Pointer = 0;
+		if (!Alloc.Call(static_cast<int32>(Size), Pointer) || Pointer == 0)
+		{
+			return 0;
+		}
+		return WasmMemoryWriteLengthPrefixedStringAt(Context, static_cast<uint32>(Pointer), Size, String) != INDEX_NONE
+			       ? static_cast<uint32>(Pointer)
+			       : 0;
+	}
+}
@@ -0,0 +1,232 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmStructMarshaler.h"
+#include "Algo/AllOf.h"
+#include "Misc/ScopeRWLock.h"
+#include "UObject/EnumProperty.h"
+#include "UObject/UnrealType.h"
+#include "UEWasmMemoryView.h"
+
+DECLARE_CYCLE_STAT(TEXT("Struct Marshaling"), STAT_WasmStructMarshaling, STATGROUP_UEWasmTime);
+
+static_assert(PLATFORM_LITTLE_ENDIAN, "Wasm memory is little endian, struct marshaling copies host values verbatim.");
+
+namespace UEWas
+{
+	struct FWasmStructLayoutBuilder
+	{
+		TWasmStructLayout& Layout;
+		uint32 GuestCursor = 0;
+
+		void AddRun(uint32 HostOffset, uint32 GuestOffset, uint32 Size)
+		{
+			if (Layout.Runs.Num() > 0)
+			{
+				TWasmStructRun& Last = Layout.Runs.Last();
+				if (Last.HostOffset + Last.Size == HostOffset && Last.GuestOffset + Last.Size == GuestOffset)
+				{
+					Last.Size += Size;
+					return;
+				}
+			}
+			Layout.Runs.Add({HostOffset, GuestOffset, Size});
+		}
+
+		void AddPrimitive(uint32 HostOffset, uint32 Size)
+		{
+			GuestCursor = Align(GuestCursor, Size);
+			AddRun(HostOffset, GuestCursor, Size);
+			GuestCursor += Size;
+			Layout.GuestAlignment = FMath::Max(Layout.GuestAlignment, Size);
+		}
+
+		bool AddStruct(const UScriptStruct* Struct, uint32 HostBase)
+		{
+			const TWasmStructLayoutPtr Nested = TWasmStructLayoutCache::Get().FindOrAdd(Struct);
+			if (!Nested->bValid)
+			{
+				Layout.Error = FString::Printf(TEXT("%s: %s"), *Struct->GetName(), *Nested->Error);
+				return false;
+			}
+
+			GuestCursor = Align(GuestCursor, Nested->GuestAlignment);
+			for (const TWasmStructRun& Run : Nested->Runs)
+			{
+				AddRun(HostBase + Run.HostOffset, GuestCursor + Run.GuestOffset, Run.Size);
+			}
+			GuestCursor += Nested->GuestSize;
+			Layout.GuestAlignment = FMath::Max(Layout.GuestAlignment, Nested->GuestAlignment);
+			return true;
+		}
+
+		bool AddProperty(const FProperty* Property)
+		{
+			for (int32 Index = 0; Index < Property->ArrayDim; Index++)
+			{
+				const uint32 HostOffset = Property->GetOffset_ForInternal() + Index * Property->ElementSize;
+				if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+				{
+					if (!AddStruct(StructProperty->Struct, HostOffset))
+					{
+						return false;
+					}
+				}
+				else if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+				{
+					if (!BoolProperty->IsNativeBool())
+					{
+						Layout.Error = FString::Printf(TEXT("Bitfield %s has no guest equivalent."), *Property->GetName());
+						return false;
+					}
+					AddPrimitive(HostOffset, Property->ElementSize);
+				}
+				else if (Property->IsA<FNumericProperty>() || Property->IsA<FEnumProperty>())
+				{
+					AddPrimitive(HostOffset, Property->ElementSize);
+				}
+				else
+				{
+					Layout.Error = FString::Printf(TEXT("%s (%s) can't be marshaled, only numbers, enums, bools and structs of them can."),
+					                               *Property->GetName(), *Property->GetClass()->GetName());
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	TWasmStructLayoutCache& TWasmStructLayoutCache::Get()
+	{
+		static TWasmStructLayoutCache Cache;
+		return Cache;
+	}
+
+	TWasmStructLayoutPtr TWasmStructLayoutCache::FindOrAdd(const UScriptStruct* Struct)
+	{
+		check(Struct);
+		{
+			FReadScopeLock ReadLock(Lock);
+			if (const TWasmStructLayoutPtr* Layout = Layouts.Find(Struct))
+			{
+				return *Layout;
+			}
+		}
+
+		// Built outside the lock, nested structs recurse into FindOrAdd. Racing builders produce identical layouts.
+		TSharedPtr<TWasmStructLayout, ESPMode::ThreadSafe> Layout = MakeShared<TWasmStructLayout, ESPMode::ThreadSafe>();
+		BuildLayout(Struct, *Layout);
+		if (!Layout->bValid)
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Struct %s has no guest layout: %s"), *Struct->GetName(), *Layout->Error);
+		}
+
+		FWriteScopeLock WriteLock(Lock);
+		if (const TWasmStructLayoutPtr* Existing = Layouts.Find(Struct))
+		{
+			return *Existing;
+		}
+
+		// Structs collected by GC or replaced by a reload never match again, drop them while we hold the lock anyway.
+		for (auto It = Layouts.CreateIterator(); It; ++It)
+		{
+			if (It.Key().IsStale())
+			{
+				It.RemoveCurrent();
+			}
+		}
+		return Layouts.Add(Struct, Layout);
+	}
+
+	void TWasmStructLayoutCache::Reset()
+	{
+		FWriteScopeLock WriteLock(Lock);
+		Layouts.Reset();
+	}
+
+	void TWasmStructLayoutCache::BuildLayout(const UScriptStruct* Struct, TWasmStructLayout& OutLayout)
+	{
+		OutLayout.Struct = Struct;
+		OutLayout.HostSize = Struct->GetStructureSize();
+
+		FWasmStructLayoutBuilder Builder{OutLayout};
+
+		// The field iterator visits a struct's own properties before inherited ones, C places the base first.
+		if (const UScriptStruct* SuperStruct = Cast<UScriptStruct>(Struct->GetSuperStruct()))
+		{
+			if (!Builder.AddStruct(SuperStruct, 0))
+			{
+				return;
+			}
+		}
+
+		for (TFieldIterator<FProperty> It(Struct, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+		{
+			if (!Builder.AddProperty(*It))
+			{
+				return;
+			}
+		}
+
+		OutLayout.GuestSize = Align(Builder.GuestCursor, OutLayout.GuestAlignment);
+		OutLayout.bMatchesHost = OutLayout.GuestSize == OutLayout.HostSize && Algo::AllOf(OutLayout.Runs, [](const TWasmStructRun& Run)
+		{
+			return Run.HostOffset == Run.GuestOffset;
+		});
+		OutLayout.bValid = true;
+	}
+
+	static bool WasmCopyStructArray(const TWasmExecutionContext& Context, uint64 GuestOffset, const UScriptStruct* Struct, uint8* Host,
+	                                int32 Num, bool bToGuest)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WasmStructMarshaling);
+
+		const TWasmStructLayoutPtr Layout = TWasmStructLayoutCache::Get().FindOrAdd(Struct);
+		if (!Layout->bValid || Num < 0)
+		{
+			return false;
+		}
+
+		const TWasmByteView View = MakeWasmMemoryView<uint8>(Context, GuestOffset, static_cast<uint64>(Layout->GuestSize) * Num);
+		if (!View.IsValid())
+		{
+			return false;
+		}
+
+		uint8* Guest = View.GetData();
+		if (Layout->bMatchesHost)
+		{
+			const SIZE_T Size = static_cast<SIZE_T>(Layout->HostSize) * Num;
+			FMemory::Memcpy(bToGuest ? Guest : Host, bToGuest ? Host : Guest, Size);
+			return true;
+		}
+
+		for (int32 Index = 0; Index < Num; Index++)
+		{
+			uint8* HostElement = Host + static_cast<SIZE_T>(Index) * Layout->HostSize;
+			uint8* GuestElement = Guest + static_cast<SIZE_T>(Index) * Layout->GuestSize;
+			for (const TWasmStructRun& Run : Layout->Runs)
+			{
+				if (bToGuest)
+				{
+					FMemory::Memcpy(GuestElement + Run.GuestOffset, HostElement + Run.HostOffset, Run.Size);
+				}
+				else
+				{
+					FMemory::Memcpy(HostElement + Run.HostOffset, GuestElement + Run.GuestOffset, Run.Size);
+				}
+			}
+		}
+		return true;
+	}
+
+	bool WasmWriteStructArray(const TWasmExecutionContext& Context, uint64 GuestOffset, const UScriptStruct* Struct, const void* Data,
+	                          int32 Num)
+	{
+		return WasmCopyStructArray(Context, GuestOffset, Struct, static_cast<uint8*>(const_cast<void*>(Data)), Num, true);
+	}
+
+	bool WasmReadStructArray(const TWasmExecutionContext& Context, uint64 GuestOffset, const UScriptStruct* Struct, void* Data, int32 Num)
+	{
+		return WasmCopyStructArray(Context, GuestOffset, Struct, static_cast<uint8*>(Data), Num, false);
+	}
+}
@@ -4,6 +4,8 @@
 #include "Core.h"
 #include "Modules/ModuleManager.h"
 #include "Interfaces/IPluginManager.h"
+#include "Misc/ScopeLock.h"
+#include "UEWasmEngineSettings.h"
 
 #define LOCTEXT_NAMESPACE "FUEWasmTimeModule"
 
@@ -39,6 +41,44 @@ void FUEWasmTimeModule::StartupModule()
 
 void FUEWasmTimeModule::ShutdownModule()
 {
+	FScopeLock Lock(&EngineProfilesLock);
+	for (const TPair<FName, FWasmEngineProfilePtr>& Pair : EngineProfiles)
+	{
+		if (Pair.Value.GetSharedReferenceCount() > 1)
+		{
+			UE_LOG(LogUEWasmTime, Warning, TEXT("Wasm engine profile %s is still referenced on shutdown."), *Pair.Key.ToString());
+		}
+	}
+	EngineProfiles.Empty();
+}
+
+FUEWasmTimeModule& FUEWasmTimeModule::Get()
+{
+	return FModuleManager::GetModuleChecked<FUEWasmTimeModule>(TEXT("UEWasmTime"));
+}
+
+FWasmEngineProfilePtr FUEWasmTimeModule::GetEngineProfile(const FName& Profile)
+{
+	FScopeLock Lock(&EngineProfilesLock);
+	if (const FWasmEngineProfilePtr* Existing = EngineProfiles.Find(Profile))
+	{
+		return *Existing;
+	}
+
+	TSharedRef<UEWas::FWasmEngineProfile, ESPMode::ThreadSafe> NewProfile = MakeShared<UEWas::FWasmEngineProfile, ESPMode::ThreadSafe>();
+	NewProfile->Name = Profile;
+	NewProfile->Settings = UEWas::FWasmEngineSettings::LoadFromConfig(Profile);
+	NewProfile->ConfigKey = NewProfile->Settings.GetConfigKey();
+	NewProfile->Engine = UEWas::MakeWasmEngine(NewProfile->Settings);
+	if (!NewProfile->Engine.IsValid())
+	{
+		UE_LOG(LogUEWasmTime, Error, TEXT("Failed to create wasm engine for profile %s."), *Profile.ToString());
+		return {};
+	}
+
+	UE_LOG(LogUEWasmTime, Log, TEXT("Created wasm engine for profile %s (%s)."), *Profile.ToString(), *NewProfile->ConfigKey);
+	EngineProfiles.Emplace(Profile, NewProfile);
+	return NewProfile;
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,35 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "UEWasmTypedFunc.h"
+
+namespace UEWas
+{
+	static bool WasmValTypesMatch(const wasm_valtype_vec_t* ValTypes, const wasm_valkind_t* Kinds, uint32 Num)
+	{
+		if (ValTypes->size != Num)
+		{
+			return false;
+		}
+
+		for (uint32 Index = 0; Index < Num; Index++)
+		{
+			if (wasm_valtype_kind(ValTypes->data[Index]) != Kinds[Index])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool WasmFuncTypeMatches(const wasm_func_t* Func, const wasm_valkind_t* ArgKinds, uint32 NumArgs, const wasm_valkind_t* ResultKinds,
+	                         uint32 NumResults)
+	{
+		check(Func);
+
+		wasm_functype_t* FuncType = wasm_func_type(Func);
+		const bool bMatches = WasmValTypesMatch(wasm_functype_params(FuncType), ArgKinds, NumArgs) &&
+			WasmValTypesMatch(wasm_functype_results(FuncType), ResultKinds, NumResults);
+		wasm_functype_delete(FuncType);
+		return bMatches;
+	}
+}
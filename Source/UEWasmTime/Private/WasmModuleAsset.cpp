@@ -0,0 +1,138 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "WasmModuleAsset.h"
+#include "UEWasmModuleCache.h"
+#include "UEWasmPreInit.h"
+
+using namespace UEWas;
+
+void UWasmModuleAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar << CompiledArtifact;
+#if WITH_EDITORONLY_DATA
+	if (!Ar.IsFilterEditorOnly())
+	{
+		Ar << SourceBinary;
+	}
+#endif
+}
+
+TWasmModule UWasmModuleAsset::LoadModule(const TWasmEngine& Engine, FString& OutErrorString, const FString& RuntimeEngineConfigKey) const
+{
+	check(Engine.Get());
+
+	if (HasCompiledArtifact() && RuntimeEngineConfigKey == EngineConfigKey && WasmtimeVersion == TEXT(WASMTIME_VERSION))
+	{
+		TWasmModule Module = MakeWasmModuleFromSerialized(Engine, CompiledArtifact.GetData(), CompiledArtifact.Num(), OutErrorString);
+		if (Module.IsValid())
+		{
+			return Module;
+		}
+	}
+
+#if WITH_EDITOR
+	if (SourceBinary.Num() > 0)
+	{
+		UE_LOG(LogUEWasmTime, Log, TEXT("%s: precompiled artifact is missing or stale, compiling source binary."), *GetPathName());
+		OutErrorString.Reset();
+		const TWasmByteVec& Binary = GetCompileBinary(Engine, OutErrorString);
+		if (Binary.IsValid())
+		{
+			return MakeWasmModuleCached(Engine, Binary, OutErrorString, RuntimeEngineConfigKey);
+		}
+	}
+#endif
+
+	if (OutErrorString.IsEmpty())
+	{
+		OutErrorString = FString::Printf(TEXT("%s has no precompiled artifact for wasmtime %s (%s)."), *GetPathName(),
+		                                 TEXT(WASMTIME_VERSION), *RuntimeEngineConfigKey);
+	}
+	UE_LOG(LogUEWasmTime, Error, TEXT("LoadModule: %s"), *OutErrorString);
+	return {};
+}
+
+#if WITH_EDITOR
+void UWasmModuleAsset::SetSourceBinary(TArray<uint8>&& InSourceBinary, const FString& InSourceFilePath)
+{
+	Modify();
+	SourceBinary = MoveTemp(InSourceBinary);
+	SourceFilePath = InSourceFilePath;
+	CompiledArtifact.Reset();
+	ArtifactKey.Reset();
+	bPreInitialized = false;
+}
+
+bool UWasmModuleAsset::Precompile(const TWasmEngine& Engine, const FString& InEngineConfigKey, FString& OutErrorString)
+{
+	check(Engine.Get());
+
+	const TWasmByteVec& Binary = GetCompileBinary(Engine, OutErrorString);
+	if (!Binary.IsValid())
+	{
+		return false;
+	}
+
+	const TWasmStore& Store = MakeWasmStore(Engine);
+	if (!WasmModuleValidate(Store, Binary, OutErrorString))
+	{
+		return false;
+	}
+
+	const TWasmModule& Module = MakeWasmModule(Engine, Binary, OutErrorString);
+	if (!Module.IsValid())
+	{
+		return false;
+	}
+
+	const TWasmByteVec& Serialized = WasmModuleSerialize(Module, OutErrorString);
+	if (!Serialized.IsValid())
+	{
+		return false;
+	}
+
+	Modify();
+	CompiledArtifact = TArray<uint8>(reinterpret_cast<const uint8*>(Serialized.Get()->Value.data), Serialized.Get()->Value.size);
+	ArtifactKey = TWasmModuleCache::Get().MakeKey(Binary, InEngineConfigKey);
+	EngineConfigKey = InEngineConfigKey;
+	WasmtimeVersion = TEXT(WASMTIME_VERSION);
+	bPreInitialized = !PreInitExport.IsEmpty();
+	return true;
+}
+
+TWasmByteVec UWasmModuleAsset::GetSourceBinary() const
+{
+	if (SourceBinary.Num() == 0)
+	{
+		return {};
+	}
+	return MakeWasmVec<TWasmByteVec>(reinterpret_cast<wasm_byte_t*>(const_cast<uint8*>(SourceBinary.GetData())), SourceBinary.Num());
+}
+
+TWasmByteVec UWasmModuleAsset::GetCompileBinary(const TWasmEngine& Engine, FString& OutErrorString) const
+{
+	if (SourceBinary.Num() == 0)
+	{
+		OutErrorString = TEXT("No source binary to compile.");
+		return {};
+	}
+
+	if (PreInitExport.IsEmpty())
+	{
+		return GetSourceBinary();
+	}
+
+	TWasmPreInitOptions Options;
+	Options.InitExport = PreInitExport;
+
+	TArray<uint8> PreInitialized;
+	if (!WasmPreInitialize(Engine, SourceBinary, Options, PreInitialized, OutErrorString))
+	{
+		OutErrorString = FString::Printf(TEXT("Pre-initializing with %s failed: %s"), *PreInitExport, *OutErrorString);
+		return {};
+	}
+	return MakeWasmVec<TWasmByteVec>(reinterpret_cast<wasm_byte_t*>(PreInitialized.GetData()), PreInitialized.Num());
+}
+#endif
@@ -2,6 +2,7 @@
 #include <memory>
 #include <string>
 #include "UEWasmTime.h"
+#include "Templates/IsInvocable.h"
 THIRD_PARTY_INCLUDES_START
 #include "wasmtime.h"
 THIRD_PARTY_INCLUDES_END
@@ -90,9 +91,53 @@ public:\
 #define DECLARE_CUSTOM_WASMTYPE_VEC_CONST(Name, WasmType, WasmVecType, AllocateFunction, DeleterFunction)\
 	DECLARE_CUSTOM_WASMTYPE_VEC_CUSTOM(Name, WasmType, WasmVecType, AllocateFunction, Allocate(WasmType& Out, WasmVecType* const* Data, uint32 Num), DeleterFunction)
 
-FORCEINLINE bool HandleErrorWithOut(FString& Out, const FString& Caller, wasmtime_error_t* ErrorPointer, wasm_trap_t* TrapPointer = nullptr,
+/**
+ * Describes the caller of a wasm operation for error messages. Only formatted once an error actually happened, so passing a
+ * literal or a formatting lambda on a hot path costs nothing when the call succeeds.
+ */
+struct TWasmErrorContext
+{
+	TWasmErrorContext(const TCHAR* InCaller)
+		: Caller(InCaller)
+	{
+	}
+
+	TWasmErrorContext(const FString& InCaller)
+		: Caller(*InCaller)
+	{
+	}
+
+	/**
+	 * Formatter returning an FString, it has to outlive the context which is the case for temporaries passed to HandleError.
+	 */
+	template <typename FormatterType, typename TEnableIf<TIsInvocable<const FormatterType&>::Value>::Type* = nullptr>
+	TWasmErrorContext(const FormatterType& InFormatter)
+		: Formatter(&InFormatter), Format([](const void* Callable) -> FString
+		{
+			return (*static_cast<const FormatterType*>(Callable))();
+		})
+	{
+	}
+
+	FString ToString() const
+	{
+		return Format ? Format(Formatter) : FString(Caller);
+	}
+
+private:
+	const TCHAR* Caller = TEXT("");
+	const void* Formatter = nullptr;
+	FString (*Format)(const void*) = nullptr;
+};
+
+FORCEINLINE bool HandleErrorWithOut(FString& Out, const TWasmErrorContext& Caller, wasmtime_error_t* ErrorPointer, wasm_trap_t* TrapPointer = nullptr,
                              bool bPrintError = true)
 {
+	if (ErrorPointer == nullptr && TrapPointer == nullptr)
+	{
+		return true;
+	}
+
 	wasm_byte_vec_t ErrorMessage = {0, nullptr};
 	if (ErrorPointer != nullptr)
 	{
@@ -110,7 +155,7 @@ FORCEINLINE bool HandleErrorWithOut(FString& Out, const FString& Caller, wasmtim
 		Out = FString(ErrorMessage.size, ErrorMessage.data);
 		if (bPrintError)
 		{
-			UE_LOG(LogUEWasmTime, Warning, TEXT("WASMError: (%s) %s"), *Caller, *Out);
+			UE_LOG(LogUEWasmTime, Warning, TEXT("WASMError: (%s) %s"), *Caller.ToString(), *Out);
 		}
 		// checkf(false, TEXT("WASMError: (%s) %s"), *Caller, *ErrorString);
 		wasm_byte_vec_delete(&ErrorMessage);
@@ -119,7 +164,7 @@ FORCEINLINE bool HandleErrorWithOut(FString& Out, const FString& Caller, wasmtim
 	return true;
 }
 
-FORCEINLINE bool HandleError(const FString& Caller, wasmtime_error_t* ErrorPointer, wasm_trap_t* TrapPointer = nullptr,
+FORCEINLINE bool HandleError(const TWasmErrorContext& Caller, wasmtime_error_t* ErrorPointer, wasm_trap_t* TrapPointer = nullptr,
 							bool bPrintError = true)
 {
 	FString ErrorString;
@@ -141,6 +186,8 @@ namespace UEWas
 
 	
 	class TWasmExecutionContext;
+	struct TWasmModuleEntry;
+	typedef TSharedPtr<const TWasmModuleEntry, ESPMode::ThreadSafe> TWasmModuleHandle;
 	DECLARE_CUSTOM_WASMTYPE(WasiConfig, wasi_config_t, wasi_config_delete);
 	DECLARE_CUSTOM_WASMTYPE(WasiInstance, wasi_instance_t, wasi_instance_delete);
 
@@ -149,11 +196,14 @@ namespace UEWas
 	DECLARE_CUSTOM_WASMTYPE(WasmInstance, wasm_instance_t, wasm_instance_delete);
 	DECLARE_CUSTOM_WASMTYPE(WasmEngine, wasm_engine_t, wasm_engine_delete);
 	DECLARE_CUSTOM_WASMTYPE(WasmModule, wasm_module_t, wasm_module_delete);
+	DECLARE_CUSTOM_WASMTYPE(WasmSharedModule, wasm_shared_module_t, wasm_shared_module_delete);
 	DECLARE_CUSTOM_WASMTYPE(WasmFuncType, wasm_functype_t, wasm_functype_delete);
 	DECLARE_CUSTOM_WASMTYPE(WasmFunc, wasm_func_t, wasm_func_delete);
 	DECLARE_CUSTOM_WASMTYPE(WasmLinker, wasmtime_linker_t, wasmtime_linker_delete);
 	DECLARE_CUSTOM_WASMTYPE(WasmGlobalVal, wasm_global_t, wasm_global_delete);
 	DECLARE_CUSTOM_WASMTYPE(WasmExport, wasm_extern_t, wasm_extern_delete);
+	DECLARE_CUSTOM_WASMTYPE(WasmMemory, wasm_memory_t, wasm_memory_delete);
+	DECLARE_CUSTOM_WASMTYPE(WasmMemoryType, wasm_memorytype_t, wasm_memorytype_delete);
 
 	// VEC types have an overhead of an additional pointer.
 	DECLARE_CUSTOM_WASMTYPE_VEC(WasmByteVec, wasm_byte_vec_t, wasm_byte_t, wasm_byte_vec_new, wasm_byte_vec_delete);
@@ -162,8 +212,52 @@ namespace UEWas
 	DECLARE_CUSTOM_WASMTYPE_VEC(WasmValVec, wasm_val_vec_t, wasm_val_t, wasm_val_vec_new, wasm_val_vec_delete);
 
 
-	// TSharedPtr checks for type completeness so we use std::shared_ptr instead.
-	typedef std::shared_ptr<wasm_valtype_t> TWasmValType;
+	/**
+	 * Interned value type of Kind, created on first use and kept for the lifetime of the process.
+	 */
+	UEWASMTIME_API const wasm_valtype_t* GetInternedWasmValType(wasm_valkind_t Kind);
+
+	/**
+	 * Non owning handle to an interned value type. Trivially copyable, signatures built from these don't allocate per type.
+	 */
+	struct TWasmValType
+	{
+		TWasmValType() = default;
+
+		explicit TWasmValType(wasm_valkind_t InKind)
+			: ValType(GetInternedWasmValType(InKind)), Kind(InKind)
+		{
+		}
+
+		FORCEINLINE const wasm_valtype_t* Get() const
+		{
+			return ValType;
+		}
+
+		FORCEINLINE wasm_valkind_t GetKind() const
+		{
+			return Kind;
+		}
+
+		FORCEINLINE bool IsValid() const
+		{
+			return ValType != nullptr;
+		}
+
+		FORCEINLINE bool operator==(const TWasmValType& Other) const
+		{
+			return ValType == Other.ValType;
+		}
+
+		FORCEINLINE bool operator!=(const TWasmValType& Other) const
+		{
+			return ValType != Other.ValType;
+		}
+
+	private:
+		const wasm_valtype_t* ValType = nullptr;
+		wasm_valkind_t Kind = 0;
+	};
 
 	typedef const wasm_extern_t* TWasmExternConst;
 	typedef wasm_extern_t* TWasmExtern;
@@ -195,16 +289,14 @@ namespace UEWas
 		return TWasmName(NamePtr);
 	}
 
+	/**
+	 * Takes ownership of InValType and returns the interned type of the same kind.
+	 */
 	FORCEINLINE TWasmValType MakeWasmValType(wasm_valtype_t* InValType)
 	{
 		check(InValType);
-		TWasmValType Val = TWasmValType(InValType, [](wasm_valtype_t* ValType)
-		{
-			if (ValType)
-			{
-				wasm_valtype_delete(ValType);
-			}
-		});
+		const TWasmValType Val = TWasmValType(wasm_valtype_kind(InValType));
+		wasm_valtype_delete(InValType);
 		return Val;
 	}
 
@@ -271,12 +363,13 @@ namespace UEWas
 	FORCEINLINE TWasmValTypeVec MakeWasmValTypeVecConst(TWasmValType* Data, const uint32& Num,
 		bool bDontDelete = false)
 	{
+		// The vector owns its elements, so it gets copies of the interned types.
 		TArray<wasm_valtype_t*> InnerValTypes;
 		InnerValTypes.Reserve(Num);
 		for (uint32 Index = 0; Index < Num; Index++)
 		{
-			check(Data[Index].get());
-			InnerValTypes.Emplace(Data[Index].get());
+			check(Data[Index].IsValid());
+			InnerValTypes.Emplace(wasm_valtype_new(Data[Index].GetKind()));
 		}
 
 		return MakeWasmVecConst<TWasmValTypeVec>(InnerValTypes.GetData(), InnerValTypes.Num(), bDontDelete);
@@ -293,34 +386,56 @@ namespace UEWas
 		return TWasmFuncType(wasm_functype_new(&Params.Get()->Value, &Results.Get()->Value));
 	}
 
+	FORCEINLINE void WasmValTypeVecCopy(wasm_valtype_vec_t& Out, const TArray<TWasmValType>& ValTypes)
+	{
+		wasm_valtype_vec_new_uninitialized(&Out, ValTypes.Num());
+		for (int32 Index = 0; Index < ValTypes.Num(); Index++)
+		{
+			check(ValTypes[Index].IsValid());
+			Out.data[Index] = wasm_valtype_new(ValTypes[Index].GetKind());
+		}
+	}
+
+	/**
+	 * Builds a function type from copies of the interned value types, wasm_functype_new takes ownership of the ones it is given.
+	 */
+	FORCEINLINE TWasmFuncType MakeWasmFuncType(const TArray<TWasmValType>& Params, const TArray<TWasmValType>& Results)
+	{
+		wasm_valtype_vec_t ParamsVec;
+		wasm_valtype_vec_t ResultsVec;
+		WasmValTypeVecCopy(ParamsVec, Params);
+		WasmValTypeVecCopy(ResultsVec, Results);
+		return TWasmFuncType(wasm_functype_new(&ParamsVec, &ResultsVec));
+	}
+
 	FORCEINLINE TWasmValType MakeWasmValTypeInt32()
 	{
-		return MakeWasmValType(wasm_valtype_new_i32());
+		return TWasmValType(WASM_I32);
 	}
 
 	FORCEINLINE TWasmValType MakeWasmValTypeInt64()
 	{
-		return MakeWasmValType(wasm_valtype_new_i64());
+		return TWasmValType(WASM_I64);
 	}
 
 	FORCEINLINE TWasmValType MakeWasmValTypeFloat32()
 	{
-		return MakeWasmValType(wasm_valtype_new_f32());
+		return TWasmValType(WASM_F32);
 	}
 
 	FORCEINLINE TWasmValType MakeWasmValTypeFloat64()
 	{
-		return MakeWasmValType(wasm_valtype_new_f64());
+		return TWasmValType(WASM_F64);
 	}
 
 	FORCEINLINE TWasmValType MakeWasmValTypeAnyRef()
 	{
-		return MakeWasmValType(wasm_valtype_new_anyref());
+		return TWasmValType(WASM_ANYREF);
 	}
 
 	FORCEINLINE TWasmValType MakeWasmValTypeFuncRef()
 	{
-		return MakeWasmValType(wasm_valtype_new_funcref());
+		return TWasmValType(WASM_FUNCREF);
 	}
 
 	FORCEINLINE TWasmLinker MakeWasmLinker(const TWasiInstance& WasiInstance, const TWasmStore& Store)
@@ -399,6 +514,84 @@ namespace UEWas
 		return TWasmModule(wasm_module_new(Store.Get(), &Binary.Get()->Value));
 	}
 
+	FORCEINLINE TWasmModule MakeWasmModule(const TWasmEngine& Engine, const TWasmByteVec& Binary, FString& OutErrorString)
+	{
+		check(Engine.Get());
+		check(Binary.Get());
+
+		wasm_module_t* RawModule = nullptr;
+		if (HandleErrorWithOut(OutErrorString, TEXT("MakeWasmModule"), wasmtime_module_new(Engine.Get(), &Binary.Get()->Value, &RawModule)))
+		{
+			return TWasmModule(RawModule);
+		}
+		return {};
+	}
+
+	FORCEINLINE bool WasmModuleValidate(const TWasmStore& Store, const TWasmByteVec& Binary, FString& OutErrorString)
+	{
+		check(Store.Get());
+		check(Binary.Get());
+		return HandleErrorWithOut(OutErrorString, TEXT("WasmModuleValidate"), wasmtime_module_validate(Store.Get(), &Binary.Get()->Value));
+	}
+
+	/**
+	 * Wraps the module in a thread safe handle, it can be turned back into a module for any store of the same engine.
+	 */
+	FORCEINLINE TWasmSharedModule WasmModuleShare(const TWasmModule& Module)
+	{
+		check(Module.Get());
+		return TWasmSharedModule(wasm_module_share(Module.Get()));
+	}
+
+	FORCEINLINE TWasmModule WasmModuleObtain(const TWasmStore& Store, const TWasmSharedModule& SharedModule)
+	{
+		check(Store.Get());
+		check(SharedModule.Get());
+		return TWasmModule(wasm_module_obtain(Store.Get(), SharedModule.Get()));
+	}
+
+	/**
+	 * Serializes the native artifact of a compiled module, the result can be handed back to MakeWasmModuleFromSerialized.
+	 */
+	FORCEINLINE TWasmByteVec WasmModuleSerialize(const TWasmModule& Module, FString& OutErrorString)
+	{
+		check(Module.Get());
+
+		TWasmByteVec Serialized = TWasmByteVec(new TWasmRef<wasm_byte_vec_t>());
+		wasm_byte_vec_new_empty(&Serialized.Get()->Value);
+		if (HandleErrorWithOut(OutErrorString, TEXT("WasmModuleSerialize"), wasmtime_module_serialize(Module.Get(), &Serialized.Get()->Value)))
+		{
+			return Serialized;
+		}
+		return {};
+	}
+
+	/**
+	 * Loads a module from a native artifact produced by WasmModuleSerialize, skipping compilation.
+	 * Fails if the artifact was produced by a different wasmtime version or an incompatible engine configuration.
+	 */
+	FORCEINLINE TWasmModule MakeWasmModuleFromSerialized(const TWasmEngine& Engine, const uint8* Data, const SIZE_T& Num, FString& OutErrorString)
+	{
+		check(Engine.Get());
+
+		// Deserialize doesn't take ownership, so we can point the vector at the caller's memory.
+		const wasm_byte_vec_t SerializedView = wasm_byte_vec_t{Num, reinterpret_cast<wasm_byte_t*>(const_cast<uint8*>(Data))};
+		wasm_module_t* RawModule = nullptr;
+		if (HandleErrorWithOut(OutErrorString, TEXT("MakeWasmModuleFromSerialized"),
+		                       wasmtime_module_deserialize(Engine.Get(), &SerializedView, &RawModule)))
+		{
+			return TWasmModule(RawModule);
+		}
+		return {};
+	}
+
+	FORCEINLINE TWasmModule MakeWasmModuleFromSerialized(const TWasmEngine& Engine, const TWasmByteVec& Serialized, FString& OutErrorString)
+	{
+		check(Serialized.Get());
+		return MakeWasmModuleFromSerialized(Engine, reinterpret_cast<const uint8*>(Serialized.Get()->Value.data), Serialized.Get()->Value.size,
+		                                    OutErrorString);
+	}
+
 	template <typename T>
 	struct TWasmValue
 	{
@@ -407,6 +600,8 @@ namespace UEWas
 	template <>
 	struct TWasmValue<int32>
 	{
+		static constexpr wasm_valkind_t Kind = WASM_I32;
+
 		static wasm_val_t NewValue(int32 InValue)
 		{
 			wasm_val_t WasmValue;
@@ -415,6 +610,11 @@ namespace UEWas
 			return WasmValue;
 		}
 
+		static int32 GetValue(const wasm_val_t& WasmValue)
+		{
+			return WasmValue.of.i32;
+		}
+
 		static TWasmValType GetType()
 		{
 			return MakeWasmValTypeInt32();
@@ -426,6 +626,11 @@ namespace UEWas
 	{		
 	};
 
+	template <>
+	struct TWasmValue<uint32> : TWasmValue<int32>
+	{
+	};
+
 	/**
 	 * Pointer.
 	 */
@@ -439,7 +644,9 @@ namespace UEWas
 	template <>
 	struct TWasmValue<int64>
 	{
-		static wasm_val_t New(int64 InValue)
+		static constexpr wasm_valkind_t Kind = WASM_I64;
+
+		static wasm_val_t NewValue(int64 InValue)
 		{
 			wasm_val_t WasmValue;
 			WasmValue.kind = WASM_I64;
@@ -447,6 +654,16 @@ namespace UEWas
 			return WasmValue;
 		}
 
+		static wasm_val_t New(int64 InValue)
+		{
+			return NewValue(InValue);
+		}
+
+		static int64 GetValue(const wasm_val_t& WasmValue)
+		{
+			return WasmValue.of.i64;
+		}
+
 		static TWasmValType GetType()
 		{
 			return MakeWasmValTypeInt64();
@@ -461,6 +678,8 @@ namespace UEWas
 	template <>
 	struct TWasmValue<float>
 	{
+		static constexpr wasm_valkind_t Kind = WASM_F32;
+
 		static wasm_val_t NewValue(float InValue)
 		{
 			wasm_val_t WasmValue;
@@ -469,6 +688,11 @@ namespace UEWas
 			return WasmValue;
 		}
 
+		static float GetValue(const wasm_val_t& WasmValue)
+		{
+			return WasmValue.of.f32;
+		}
+
 		static TWasmValType GetType()
 		{
 			return MakeWasmValTypeFloat32();
@@ -478,6 +702,8 @@ namespace UEWas
 	template <>
 	struct TWasmValue<double>
 	{
+		static constexpr wasm_valkind_t Kind = WASM_F64;
+
 		static wasm_val_t NewValue(double InValue)
 		{
 			wasm_val_t WasmValue;
@@ -486,6 +712,11 @@ namespace UEWas
 			return WasmValue;
 		}
 
+		static double GetValue(const wasm_val_t& WasmValue)
+		{
+			return WasmValue.of.f64;
+		}
+
 		static TWasmValType GetType()
 		{
 			return MakeWasmValTypeFloat64();
@@ -495,6 +726,8 @@ namespace UEWas
 	template <>
 	struct TWasmValue<wasm_ref_t*>
 	{
+		static constexpr wasm_valkind_t Kind = WASM_ANYREF;
+
 		static wasm_val_t NewValue(wasm_ref_t* InValue)
 		{
 			wasm_val_t WasmValue;
@@ -503,6 +736,11 @@ namespace UEWas
 			return WasmValue;
 		}
 
+		static wasm_ref_t* GetValue(const wasm_val_t& WasmValue)
+		{
+			return WasmValue.of.ref;
+		}
+
 		static TWasmValType GetType()
 		{
 			return MakeWasmValTypeAnyRef();
@@ -537,6 +775,8 @@ namespace UEWas
 		TWasmName Name;
 		TArray<TWasmValType> ArgumentsSignatureArray;
 		TArray<TWasmValType> ResultSignatureArray;
+		/** Built once from the signature arrays and shared by every context the function is linked into. */
+		TWasmFuncType FuncType;
 		wasmtime_func_callback_with_env_t ImportCallback;
 	public:
 		TWasmFunctionSignature(TWasmFunctionSignature&& MoveSignature)
@@ -545,6 +785,7 @@ namespace UEWas
 			Name = MoveTemp(MoveSignature.Name);
 			ArgumentsSignatureArray = MoveTemp(MoveSignature.ArgumentsSignatureArray);
 			ResultSignatureArray = MoveTemp(MoveSignature.ResultSignatureArray);
+			FuncType = MoveTemp(MoveSignature.FuncType);
 			ImportCallback = MoveTempIfPossible(MoveSignature.ImportCallback);
 		};
 
@@ -555,6 +796,7 @@ namespace UEWas
 			Name = MakeWasmName(InFunctionName);
 			ArgumentsSignatureArray = MoveTemp(InArgsSignature);
 			ResultSignatureArray = MoveTemp(InResultSignature);
+			FuncType = MakeWasmFuncType(ArgumentsSignatureArray, ResultSignatureArray);
 			ImportCallback = InImportCallback;
 		};
 
@@ -566,6 +808,7 @@ namespace UEWas
 			Name = MakeWasmName(InFunctionName);
 			ArgumentsSignatureArray = InArgsSignature;
 			ResultSignatureArray = InResultSignature;
+			FuncType = MakeWasmFuncType(ArgumentsSignatureArray, ResultSignatureArray);
 			ImportCallback = InImportCallback;
 		};
 
@@ -580,6 +823,28 @@ namespace UEWas
 		bool Call(const uint32& FuncExternIndex, const TWasmInstance& Instance, TArray<wasm_val_t> Args,
 		          TArray<wasm_val_t>& Results, bool bPrintError = true);
 
+		/**
+		 * Calls the export through the function Context resolved at instantiation. Doesn't allocate, Results has to hold one
+		 * value per result of the signature.
+		 */
+		bool Call(const TWasmExecutionContext& Context, const uint32& FuncExternIndex, TArrayView<const wasm_val_t> Args,
+		          TArrayView<wasm_val_t> Results, bool bPrintError = true) const;
+
+		/**
+		 * Calls an already resolved function, straight to wasmtime_func_call.
+		 */
+		bool Call(wasm_func_t* Func, TArrayView<const wasm_val_t> Args, TArrayView<wasm_val_t> Results, bool bPrintError = true) const;
+
+		/**
+		 * Calls the export NumItems times in one go. Args holds one argument tuple per item back to back, Results receives one result
+		 * tuple per item the same way. The function is resolved and the buffers validated once per batch.
+		 * Items that trapped get their bit set in OutTrapMask, the remaining items still run.
+		 * @return Number of items that completed, INDEX_NONE if the batch couldn't run at all.
+		 */
+		int32 CallBatch(const TWasmExecutionContext& Context, const uint32& FuncExternIndex, const int32& NumItems,
+		                TArrayView<const wasm_val_t> Args, TArrayView<wasm_val_t> Results, TBitArray<>& OutTrapMask,
+		                bool bPrintError = false) const;
+
 		bool ExistsAsExtern(const TWasmItemMapPtr& InExternMapping) const;
 
 
@@ -588,6 +853,11 @@ namespace UEWas
 			return WasmNameToString(Name);
 		}
 
+		FORCEINLINE const TWasmFuncType& GetFuncType() const
+		{
+			return FuncType;
+		}
+
 		FORCEINLINE FString GetModuleName() const
 		{
 			return WasmNameToString(ModuleName);
@@ -637,9 +907,80 @@ namespace UEWas
 	}
 
 
+	/**
+	 * How a context's linear memory is sized, see TWasmExecutionContext::SetMemoryPolicy. Combine it with an engine profile whose
+	 * StaticMemoryMaximumSize covers MaximumPages, growth inside a static memory's reservation never moves the memory.
+	 */
+	struct UEWASMTIME_API TWasmMemoryPolicy
+	{
+		/** Pages the memory is grown to up front, the expected working set. 0 keeps the module's minimum. */
+		uint32 InitialPages = 0;
+		/** Cap in 64KiB pages, 0 leaves it to the module. */
+		uint32 MaximumPages = 0;
+		/** Logs every growth instead of only those past the cap. */
+		bool bLogGrowth = false;
+	};
+
+	struct UEWASMTIME_API TWasmMemoryGrowEvent
+	{
+		double Timestamp = 0.0;
+		uint64 Frame = 0;
+		uint32 OldPages = 0;
+		uint32 NewPages = 0;
+		/** Grown through ReserveMemoryPages rather than by a guest memory.grow. */
+		bool bHostInitiated = false;
+	};
+
+	/**
+	 * Bytes a context holds, see TWasmMemoryAccounting. Only exported memories and tables are visible to the host.
+	 */
+	struct UEWASMTIME_API TWasmMemoryUsage
+	{
+		uint64 MemoryBytes = 0;
+		uint64 TableBytes = 0;
+		/** Estimated, wasmtime doesn't report what a store allocates. */
+		uint64 StoreBytes = 0;
+
+		FORCEINLINE uint64 GetTotal() const
+		{
+			return MemoryBytes + TableBytes + StoreBytes;
+		}
+
+		FORCEINLINE TWasmMemoryUsage& operator+=(const TWasmMemoryUsage& Other)
+		{
+			MemoryBytes += Other.MemoryBytes;
+			TableBytes += Other.TableBytes;
+			StoreBytes += Other.StoreBytes;
+			return *this;
+		}
+
+		FORCEINLINE TWasmMemoryUsage& operator-=(const TWasmMemoryUsage& Other)
+		{
+			MemoryBytes -= Other.MemoryBytes;
+			TableBytes -= Other.TableBytes;
+			StoreBytes -= Other.StoreBytes;
+			return *this;
+		}
+	};
+
+	/**
+	 * Guest state captured by TWasmExecutionContext::Snapshot.
+	 */
+	struct UEWASMTIME_API TWasmContextSnapshot
+	{
+		TArray<uint8> Memory;
+		/** Export index and value of every mutable numeric global. */
+		TArray<TPair<uint32, wasm_val_t>> Globals;
+		bool bValid = false;
+	};
+
+	class TWasmSharedMemoryGroup;
+
 	class UEWASMTIME_API TWasmExecutionContext
 	{
 	public:
+		/** Owns Store when the context belongs to a shared memory group, declared first so it's released after the store handles. */
+		TSharedPtr<TWasmSharedMemoryGroup, ESPMode::ThreadSafe> MemoryGroup;
 		TWasmStore Store;
 		TWasiInstance LinkerInstance;
 		TWasmLinker Linker;
@@ -649,8 +990,11 @@ namespace UEWas
 		void* AdditionalEnvironment;
 		FString Error;
 
+		/** Keeps the interned module alive when the context was created from the module registry. */
+		TWasmModuleHandle ModuleHandle;
+
 	protected:
-		bool bValid;
+		bool bValid = false;
 
 	public:
 		TWasmExecutionContext(const TWasmModule& Module, const TWasmEngine& InEngine,
@@ -660,8 +1004,38 @@ namespace UEWas
 		{
 			ExternMapping = InExternMapping;
 			HostFunctionMapping = InHostFunctionMapping;
-			TWasiConfig TempConfig = MakeWasiConfig();
+			if (CreateLinker(InEngine, HostFunctions, WorkspacePath))
+			{
+				Instantiate(Module);
+			}
+		}
+
+		/**
+		 * Instantiates a module interned by TWasmModuleRegistry, the compiled code is shared with every other context using it.
+		 * InEngine has to be the engine the module was registered with.
+		 */
+		TWasmExecutionContext(const TWasmModuleHandle& InModule, const TWasmEngine& InEngine,
+		                      const TArray<TWasmFunctionSignaturePtr>& HostFunctions, const FString& WorkspacePath);
+
+		/**
+		 * Instantiates a module into the store of InMemoryGroup, its memory import is satisfied by the group's memory.
+		 * Use TWasmSharedMemoryGroup::CreateContext.
+		 */
+		TWasmExecutionContext(const TWasmModuleHandle& InModule, const TSharedRef<TWasmSharedMemoryGroup, ESPMode::ThreadSafe>& InMemoryGroup,
+		                      const TArray<TWasmFunctionSignaturePtr>& HostFunctions, const FString& WorkspacePath);
+
+		~TWasmExecutionContext();
+
+	protected:
+		bool CreateLinker(const TWasmEngine& InEngine, const TArray<TWasmFunctionSignaturePtr>& HostFunctions, const FString& WorkspacePath)
+		{
 			Store = MakeWasmStore(InEngine);
+			return CreateLinkerInStore(HostFunctions, WorkspacePath);
+		}
+
+		bool CreateLinkerInStore(const TArray<TWasmFunctionSignaturePtr>& HostFunctions, const FString& WorkspacePath)
+		{
+			TWasiConfig TempConfig = MakeWasiConfig();
 			if (Store.IsValid())
 			{
 				// Lock directory.
@@ -695,28 +1069,235 @@ namespace UEWas
 #endif
 									}
 								}
-
-								Instance = MakeWasmInstance(Module, Linker, Error);
-								if (Instance.IsValid() && Error.IsEmpty())
-								{
-									bValid = true;
-								}
-
-								if(!Error.IsEmpty())
-								{
-									bValid = false;
-								}
+								return true;
 							}
 						}
 					}
 				}
 			}
+			return false;
+		}
+
+		void Instantiate(const TWasmModule& Module)
+		{
+			Instance = MakeWasmInstance(Module, Linker, Error);
+			if (Instance.IsValid() && Error.IsEmpty())
+			{
+				bValid = true;
+				ResolveExports();
+				if (!AddToMemoryAccounting())
+				{
+					bValid = false;
+				}
+			}
+
+			if(!Error.IsEmpty())
+			{
+				bValid = false;
+			}
+		}
+
+		void ResolveExports()
+		{
+			Exports = WasmGetInstanceExports(Instance);
+			const uint32* MemoryIndex = ExternMapping->Find(TEXT("memory"));
+			Memory = MemoryIndex ? GetExportMemory(*MemoryIndex) : SharedMemory;
+			if (Memory)
+			{
+				// Baseline for grow events.
+				GetMemoryEpoch();
+			}
+		}
+
+		/** Exports of Instance resolved once at instantiation, indexed like ExternMapping. */
+		TWasmExternVec Exports;
+		/** The "memory" export, or the memory group's memory if the module imports it without exporting it. */
+		wasm_memory_t* Memory = nullptr;
+		/** Memory of MemoryGroup, not accounted to the context. */
+		wasm_memory_t* SharedMemory = nullptr;
+
+		mutable byte_t* CachedMemoryData = nullptr;
+		mutable SIZE_T CachedMemorySize = 0;
+		mutable uint32 MemoryEpoch = 0;
+
+		void UpdateMemoryCache(bool bHostInitiated) const;
+
+		TWasmMemoryPolicy MemoryPolicy;
+		mutable TArray<TWasmMemoryGrowEvent> MemoryGrowEvents;
+		mutable uint32 NumMemoryGrowEvents = 0;
+
+		bool AddToMemoryAccounting();
+
+		bool bMemoryAccounted = false;
+
+	public:
+		FORCEINLINE wasm_extern_t* GetExport(const uint32& ExternIndex) const
+		{
+			if (Exports.IsValid() && ExternIndex < Exports.Get()->Value.size)
+			{
+				return Exports.Get()->Value.data[ExternIndex];
+			}
+			return nullptr;
+		}
+
+		FORCEINLINE wasm_extern_t* FindExport(const FName& ExportName) const
+		{
+			const uint32* ExternIndex = ExternMapping.IsValid() ? ExternMapping->Find(ExportName) : nullptr;
+			return ExternIndex ? GetExport(*ExternIndex) : nullptr;
+		}
+
+		FORCEINLINE wasm_func_t* GetExportFunction(const uint32& ExternIndex) const
+		{
+			wasm_extern_t* Extern = GetExport(ExternIndex);
+			return Extern ? wasm_extern_as_func(Extern) : nullptr;
+		}
+
+		FORCEINLINE wasm_memory_t* GetExportMemory(const uint32& ExternIndex) const
+		{
+			wasm_extern_t* Extern = GetExport(ExternIndex);
+			return Extern ? wasm_extern_as_memory(Extern) : nullptr;
+		}
+
+		FORCEINLINE wasm_global_t* GetExportGlobal(const uint32& ExternIndex) const
+		{
+			wasm_extern_t* Extern = GetExport(ExternIndex);
+			return Extern ? wasm_extern_as_global(Extern) : nullptr;
+		}
+
+		FORCEINLINE wasm_table_t* GetExportTable(const uint32& ExternIndex) const
+		{
+			wasm_extern_t* Extern = GetExport(ExternIndex);
+			return Extern ? wasm_extern_as_table(Extern) : nullptr;
+		}
+
+		FORCEINLINE uint32 GetNumExports() const
+		{
+			return Exports.IsValid() ? Exports.Get()->Value.size : 0;
+		}
+
+		/**
+		 * The linear memory exported as "memory", or null if the module doesn't export one.
+		 */
+		FORCEINLINE wasm_memory_t* GetMemory() const
+		{
+			return Memory;
+		}
+
+		/**
+		 * Counter bumped whenever the memory was seen at a new address or size, i.e. memory.grow ran since the last query.
+		 * Pointers into memory taken at an older epoch may dangle, see TWasmMemoryView.
+		 */
+		FORCEINLINE uint32 GetMemoryEpoch() const
+		{
+			if (Memory && (wasm_memory_data(Memory) != CachedMemoryData || wasm_memory_data_size(Memory) != CachedMemorySize))
+			{
+				UpdateMemoryCache(false);
+			}
+			return MemoryEpoch;
+		}
+
+		/**
+		 * Base and size of the memory as of the last GetMemoryEpoch.
+		 */
+		FORCEINLINE byte_t* GetCachedMemoryData() const
+		{
+			return CachedMemoryData;
+		}
+
+		FORCEINLINE SIZE_T GetCachedMemorySize() const
+		{
+			return CachedMemorySize;
+		}
+
+		/**
+		 * Applies InPolicy and grows the memory to its InitialPages. Growth past MaximumPages is refused for the host. A guest
+		 * memory.grow can't be stopped through the wasmtime 0.26 API, growing past the cap is reported and flagged instead.
+		 */
+		bool SetMemoryPolicy(const TWasmMemoryPolicy& InPolicy);
+
+		FORCEINLINE const TWasmMemoryPolicy& GetMemoryPolicy() const
+		{
+			return MemoryPolicy;
+		}
+
+		/**
+		 * Grows the memory to at least NumPages in a single step.
+		 */
+		bool ReserveMemoryPages(uint32 NumPages);
+
+		FORCEINLINE uint32 GetMemoryPages() const
+		{
+			return Memory ? wasm_memory_size(Memory) : 0;
+		}
+
+		/**
+		 * The most recent growths seen, oldest first. Guest growth is noticed on the next memory epoch query.
+		 */
+		FORCEINLINE const TArray<TWasmMemoryGrowEvent>& GetMemoryGrowEvents() const
+		{
+			GetMemoryEpoch();
+			return MemoryGrowEvents;
+		}
+
+		FORCEINLINE uint32 GetNumMemoryGrowEvents() const
+		{
+			GetMemoryEpoch();
+			return NumMemoryGrowEvents;
+		}
+
+		FORCEINLINE bool IsOverMemoryCap() const
+		{
+			return MemoryPolicy.MaximumPages > 0 && GetMemoryPages() > MemoryPolicy.MaximumPages;
 		}
 
+		/**
+		 * Measures the exported memory and tables, nothing is cached.
+		 */
+		TWasmMemoryUsage GetMemoryUsage() const;
+
+		/**
+		 * Reports the current usage to TWasmMemoryAccounting. Memory growth is reported on its own, call this after the guest grew
+		 * a table.
+		 */
+		void UpdateMemoryAccounting() const;
+
 		FORCEINLINE bool IsValid() const
 		{
 			return bValid;
 		}
+
+		/**
+		 * Values of the mutable numeric exported globals, keyed by export index.
+		 */
+		void CaptureGlobals(TArray<TPair<uint32, wasm_val_t>>& OutGlobals) const;
+		void RestoreGlobals(const TArray<TPair<uint32, wasm_val_t>>& Globals);
+
+		/**
+		 * Captures linear memory and the mutable exported globals, usually right after initialization.
+		 * Globals the module doesn't export can't be reached through the C API and aren't captured.
+		 */
+		bool Snapshot();
+
+		/**
+		 * Rolls memory and globals back to the last snapshot, only blocks that differ from it are written.
+		 * Finding them still compares the whole memory against the snapshot, a restore costs O(memory size) even when the guest
+		 * touched a single page. For large instances that runs to milliseconds, keep it off the game thread.
+		 * Memories can't shrink, pages the guest grew since the snapshot are zeroed but stay allocated.
+		 */
+		bool Restore();
+
+		FORCEINLINE bool HasSnapshot() const
+		{
+			return SavedState.bValid;
+		}
+
+		FORCEINLINE const TWasmContextSnapshot& GetSnapshot() const
+		{
+			return SavedState;
+		}
+
+	protected:
+		TWasmContextSnapshot SavedState;
 	};
 
 	typedef TUniquePtr<TWasmExecutionContext> TWasmExecutionContextPtr;
@@ -733,29 +1314,12 @@ namespace UEWas
 
 	FORCEINLINE byte_t* GetWasmExecutionMemory(const TWasmExecutionContext& Context, uint64_t& MemorySize, uint64_t& MemoryDataSize)
 	{
-		const uint32* MemoryIndex = Context.ExternMapping->Find(TEXT("memory"));
-		if (MemoryIndex)
+		wasm_memory_t* Memory = Context.GetMemory();
+		if (Memory)
 		{
-			const TWasmExternVec& Exports = WasmGetInstanceExports(Context.Instance);
-			if (!Exports.IsValid())
-			{
-				UE_LOG(LogUEWasmTime, Warning, TEXT("Error accessing export export!"));
-				return nullptr;
-			}
-
-			if (Exports.Get()->Value.size < *MemoryIndex)
-			{
-				UE_LOG(LogUEWasmTime, Warning, TEXT("Tried calling non-existent export!"));
-				return nullptr;
-			}
-
-			const auto Memory = wasm_extern_as_memory(Exports.Get()->Value.data[*MemoryIndex]);
-			if (Memory)
-			{
-				MemorySize = wasm_memory_size(Memory);
-				MemoryDataSize = wasm_memory_data_size(Memory);
-				return wasm_memory_data(Memory);
-			}
+			MemorySize = wasm_memory_size(Memory);
+			MemoryDataSize = wasm_memory_data_size(Memory);
+			return wasm_memory_data(Memory);
 		}
 		return nullptr;
 	}
@@ -838,39 +1402,26 @@ namespace UEWas
 	// 	return Exports;
 	// }
 
+	/**
+	 * Reads a NUL terminated UTF-8 string at Offset, scanning at most MaxBytes. See UEWasmString.h for the context based helpers.
+	 */
+	UEWASMTIME_API FString WasmReadUtf8String(const uint8* Memory, uint64 MemorySize, uint64 Offset, uint64 MaxBytes);
+
+	/**
+	 * Reads a string of up to NumChars bytes through the caller's memory export. Host functions get their TWasmExecutionContext
+	 * as environment, WasmMemoryReadString on it skips the export lookup.
+	 */
 	FORCEINLINE FString WasmMemoryReadString(const wasmtime_caller_t* Caller, const int32& PointerOffset, const int32& NumChars)
 	{
-		const TWasmExport& Export = WasmGetCallerExport(Caller, TEXT("memory"));
-		if (Export.IsValid())
-		{
-			wasm_memory_t* Memory = wasm_extern_as_memory(Export.Get());
-			if (Memory)
-			{
-				const uint64_t NumBytesMemory = wasm_memory_data_size(Memory);
-				const uint64_t Address = PointerOffset;
-				const uint64_t StringLength = NumChars;
-				if (NumBytesMemory > 0 && NumBytesMemory > (Address + StringLength) && NumBytesMemory > Address)
-				{
-					TArray<byte_t> Copied;
-					Copied.Reserve(StringLength);
+		static char MemoryExportName[] = "memory";
+		static const wasm_name_t MemoryName = wasm_name_t{UE_ARRAY_COUNT(MemoryExportName) - 1, MemoryExportName};
 
-					byte_t* Data = wasm_memory_data(Memory);
-					for (uint64_t Index = 0; Index < StringLength; Index++)
-					{
-						const TCHAR& Char = Data[Address + Index];
-						Copied.Emplace(Char);
-						if (Char == '\0')
-						{
-							break;
-						}
-					}
-
-					if (Copied.Num() > 0)
-					{
-						return FString(Copied.Num() - 1, Copied.GetData());
-					}
-				}
-			}
+		const TWasmExport Export = TWasmExport(wasmtime_caller_export_get(Caller, &MemoryName));
+		wasm_memory_t* Memory = Export.IsValid() ? wasm_extern_as_memory(Export.Get()) : nullptr;
+		if (Memory && PointerOffset >= 0 && NumChars > 0)
+		{
+			return WasmReadUtf8String(reinterpret_cast<const uint8*>(wasm_memory_data(Memory)), wasm_memory_data_size(Memory), PointerOffset,
+			                          NumChars);
 		}
 		return TEXT("");
 	}
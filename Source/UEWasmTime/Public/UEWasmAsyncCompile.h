@@ -0,0 +1,33 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	struct UEWASMTIME_API TWasmCompileResult
+	{
+		TWasmModule Module;
+		FString Error;
+
+		FORCEINLINE bool IsValid() const
+		{
+			return Module.IsValid();
+		}
+	};
+
+	/**
+	 * Compiles Binary on a worker thread through the module cache. Engine has to outlive the returned future.
+	 */
+	UEWASMTIME_API TFuture<TWasmCompileResult> MakeWasmModuleAsync(const TWasmEngine& Engine, TWasmByteVec&& Binary,
+	                                                               const FString& EngineConfigKey);
+
+	/**
+	 * Compiles a batch of binaries spread across all worker threads. Results keep the order of Binaries.
+	 * Engine has to outlive the returned future.
+	 */
+	UEWASMTIME_API TFuture<TArray<TWasmCompileResult>> MakeWasmModulesAsync(const TWasmEngine& Engine, TArray<TWasmByteVec>&& Binaries,
+	                                                                        const FString& EngineConfigKey);
+}
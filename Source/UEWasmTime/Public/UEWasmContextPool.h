@@ -0,0 +1,133 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include <atomic>
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "UEWasmAPI.h"
+#include "UEWasmTime.h"
+
+namespace UEWas
+{
+	struct UEWASMTIME_API TWasmContextPoolStats
+	{
+		/** Acquires served by a warm context. */
+		uint64 Hits = 0;
+		/** Acquires that had to instantiate synchronously. */
+		uint64 Misses = 0;
+		/** Contexts instantiated in the background. */
+		uint64 Refills = 0;
+		/** Released contexts rolled back to their snapshot instead of being replaced. */
+		uint64 Restores = 0;
+		double LastRefillSeconds = 0.0;
+		double AverageRefillSeconds = 0.0;
+		int32 NumIdle = 0;
+		int32 NumPending = 0;
+	};
+
+	/**
+	 * Keeps a number of instantiated contexts of one module warm, so Acquire hands one out without building a store, linking host
+	 * functions and instantiating on the calling thread. Released contexts are replaced by fresh instances in the background.
+	 *
+	 * Contexts are created on worker threads and handed over whole, nothing else may keep references into a pooled context's store.
+	 *
+	 * With SetRestoreOnRelease, contexts are snapshotted after instantiation and released ones are rolled back to that snapshot
+	 * instead of being rebuilt. Only memory and exported globals are restored, guests keeping state elsewhere need replacing.
+	 */
+	class UEWASMTIME_API TWasmContextPool : public TSharedFromThis<TWasmContextPool, ESPMode::ThreadSafe>
+	{
+	public:
+		/**
+		 * @param InEngineProfile Engine the module was registered with, kept alive by the pool.
+		 * @param InTargetSize Number of warm contexts to keep around.
+		 */
+		TWasmContextPool(const TWasmModuleHandle& InModule, const FWasmEngineProfilePtr& InEngineProfile,
+		                 const TArray<TWasmFunctionSignaturePtr>& InHostFunctions, const FString& InWorkspacePath, int32 InTargetSize);
+
+		static TSharedRef<TWasmContextPool, ESPMode::ThreadSafe> Create(const TWasmModuleHandle& InModule, const FWasmEngineProfilePtr& InEngineProfile,
+		                                                                const TArray<TWasmFunctionSignaturePtr>& InHostFunctions,
+		                                                                const FString& InWorkspacePath, int32 InTargetSize);
+
+		/**
+		 * Hands out a warm context, or instantiates one synchronously when the pool ran dry.
+		 */
+		TWasmExecutionContextPtr Acquire();
+
+		/**
+		 * Gives a context back. Its state is discarded, it's restored or a fresh instance takes its place in the background.
+		 */
+		void Release(TWasmExecutionContextPtr&& Context);
+
+		/**
+		 * Fills the pool up to its target size on the calling thread, e.g. while loading.
+		 */
+		void Prewarm();
+
+		void SetTargetSize(int32 InTargetSize);
+
+		/**
+		 * Only affects contexts created afterwards.
+		 */
+		FORCEINLINE void SetRestoreOnRelease(bool bInRestoreOnRelease)
+		{
+			bRestoreOnRelease = bInRestoreOnRelease;
+		}
+
+		/**
+		 * Applied to contexts before they're pooled, so their memory is already grown to the working set. Only affects contexts
+		 * created afterwards.
+		 */
+		void SetMemoryPolicy(const TWasmMemoryPolicy& InMemoryPolicy);
+
+		TWasmContextPoolStats GetStats() const;
+
+		/**
+		 * When the least recently released idle context was released, false if the pool has none. Used by TWasmMemoryAccounting.
+		 */
+		bool GetOldestIdleTime(double& OutSeconds) const;
+
+		/**
+		 * Destroys the least recently released idle context, it's not replaced until the pool is used again.
+		 */
+		bool EvictOldestIdle();
+
+		FORCEINLINE const TWasmModuleHandle& GetModule() const
+		{
+			return Module;
+		}
+
+	protected:
+		struct TIdleContext
+		{
+			TWasmExecutionContextPtr Context;
+			double IdleSince;
+		};
+
+		TWasmExecutionContextPtr CreateContext() const;
+		void RequestRefill();
+		void AddRefilledContext(TWasmExecutionContextPtr&& Context, double Seconds);
+		void AddRestoredContext(TWasmExecutionContextPtr&& Context);
+
+		TWasmModuleHandle Module;
+		FWasmEngineProfilePtr EngineProfile;
+		TArray<TWasmFunctionSignaturePtr> HostFunctions;
+		FString WorkspacePath;
+
+		mutable FCriticalSection Lock;
+		/** Least recently released first. */
+		TArray<TIdleContext> IdleContexts;
+		int32 TargetSize;
+		int32 NumPending = 0;
+		std::atomic<bool> bRestoreOnRelease;
+		TWasmMemoryPolicy MemoryPolicy;
+
+		std::atomic<uint64> Hits;
+		std::atomic<uint64> Misses;
+		uint64 Refills = 0;
+		uint64 Restores = 0;
+		double LastRefillSeconds = 0.0;
+		double TotalRefillSeconds = 0.0;
+	};
+
+	typedef TSharedPtr<TWasmContextPool, ESPMode::ThreadSafe> TWasmContextPoolPtr;
+}
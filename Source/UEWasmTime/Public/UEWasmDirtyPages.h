@@ -0,0 +1,138 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	/**
+	 * Pages and globals that changed between two captures of a TWasmDirtyPageTracker. Each page is stored as it was before and
+	 * after, so a delta can be applied as well as reverted.
+	 */
+	struct UEWASMTIME_API TWasmMemoryDelta
+	{
+		/** Baseline of the tracker that captured the delta, sequences only mean something within one baseline. */
+		FGuid Baseline;
+		/** State the delta leads from. */
+		int32 BaseSequence = INDEX_NONE;
+		/** State the delta leads to, unique per tracker. */
+		int32 Sequence = INDEX_NONE;
+		uint64 BaseMemorySize = 0;
+		uint64 MemorySize = 0;
+		/** Indices of the changed pages, ascending. */
+		TArray<uint32> Pages;
+		TArray64<uint8> OldData;
+		TArray64<uint8> NewData;
+		TArray<TPair<uint32, wasm_val_t>> BaseGlobals;
+		TArray<TPair<uint32, wasm_val_t>> Globals;
+
+		FORCEINLINE bool IsValid() const
+		{
+			return Sequence != INDEX_NONE;
+		}
+
+		FORCEINLINE SIZE_T GetAllocatedSize() const
+		{
+			return Pages.GetAllocatedSize() + OldData.GetAllocatedSize() + NewData.GetAllocatedSize() + BaseGlobals.GetAllocatedSize() +
+				Globals.GetAllocatedSize();
+		}
+	};
+
+	/**
+	 * Incremental snapshots of a context's linear memory, e.g. one per simulation tick for rollback. Captures only store the pages
+	 * written since the previous capture.
+	 *
+	 * Pages are found by comparing the memory against a shadow copy of the last captured state. OS write tracking doesn't fit an
+	 * embedded runtime: soft-dirty bits are cleared for the whole process at once, wasmtime owns the fault handlers mprotect and
+	 * userfaultfd would need, and Windows write watches have to be requested when the memory is allocated.
+	 *
+	 * The tracker must be used on the thread owning the context and must not outlive it.
+	 */
+	class UEWASMTIME_API TWasmDirtyPageTracker
+	{
+	public:
+		static constexpr uint32 PageSize = 4096;
+
+		explicit TWasmDirtyPageTracker(TWasmExecutionContext& InContext);
+
+		/**
+		 * Takes the current state as a new baseline, copying the whole memory once. Deltas captured before don't apply anymore.
+		 */
+		bool Begin();
+
+		/**
+		 * Moves the pages changed since the previous capture into OutDelta and makes the current state the new baseline.
+		 */
+		bool Capture(TWasmMemoryDelta& OutDelta);
+
+		/**
+		 * Throws away everything written since the last capture.
+		 */
+		bool Discard();
+
+		/**
+		 * Moves forward along deltas captured in order, starting at the current state. Pages written more than once along the chain
+		 * are copied once. Changes since the last capture are discarded first. Deltas of another tracker or baseline are refused.
+		 */
+		bool ApplyChain(TArrayView<const TWasmMemoryDelta> Deltas);
+
+		/**
+		 * Moves back along deltas captured in order, the last one has to lead to the current state.
+		 */
+		bool RevertChain(TArrayView<const TWasmMemoryDelta> Deltas);
+
+		FORCEINLINE bool Apply(const TWasmMemoryDelta& Delta)
+		{
+			return ApplyChain(MakeArrayView(&Delta, 1));
+		}
+
+		FORCEINLINE bool Revert(const TWasmMemoryDelta& Delta)
+		{
+			return RevertChain(MakeArrayView(&Delta, 1));
+		}
+
+		FORCEINLINE bool IsTracking() const
+		{
+			return Sequence != INDEX_NONE;
+		}
+
+		/**
+		 * State the memory was in at the last capture, apply or revert.
+		 */
+		FORCEINLINE int32 GetSequence() const
+		{
+			return Sequence;
+		}
+
+		FORCEINLINE const FGuid& GetBaseline() const
+		{
+			return Baseline;
+		}
+
+		FORCEINLINE const FString& GetError() const
+		{
+			return Error;
+		}
+
+	protected:
+		bool CheckBaseline(const TWasmMemoryDelta& Delta);
+		/** Brings the shadow up to the memory's size, grown pages compare against the zeroes wasm fills them with. */
+		bool SyncShadowSize();
+		/**
+		 * Copies Pages into memory and shadow, growing the memory to MemorySize first. Captures compare against the zero extended
+		 * shadow, so the pages of a chain cover every difference and nothing past MemorySize needs clearing.
+		 */
+		bool WritePages(const TMap<uint32, const uint8*>& Pages, uint64 MemorySize);
+
+		TWasmExecutionContext* Context;
+		/** Memory as of the current sequence, sized like the memory. */
+		TArray64<uint8> Shadow;
+		TArray<TPair<uint32, wasm_val_t>> ShadowGlobals;
+		/** Made anew by every Begin. */
+		FGuid Baseline;
+		int32 Sequence = INDEX_NONE;
+		int32 NextSequence = 0;
+		FString Error;
+	};
+}
@@ -0,0 +1,108 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	enum class EWasmEnginePreset : uint8
+	{
+		/** Wasmtime defaults. */
+		Default,
+		/** Fully optimized code, SIMD and large static memories with guard regions so bounds checks are elided. */
+		MaxThroughput,
+		/** Dynamic memories with small guard regions, trades some execution speed for a much smaller address space footprint. */
+		LowMemory,
+		/** Unoptimized code generation, compiles the fastest. */
+		FastStartup,
+	};
+
+	/**
+	 * Typed wasmtime engine configuration. Every WASMTIME_CONFIG_PROP is exposed, sizes and counts left negative keep the
+	 * wasmtime default.
+	 *
+	 * Profiles are read from the engine ini, [WasmTime.Engine] is the default profile and [WasmTime.Engine.<Name>] are named ones:
+	 *
+	 *   [WasmTime.Engine]
+	 *   Preset=MaxThroughput
+	 *   StaticMemoryMaximumSize=1073741824
+	 *
+	 * Preset selects the base values, every other key overrides them.
+	 */
+	struct UEWASMTIME_API FWasmEngineSettings
+	{
+		wasmtime_strategy_t Strategy = WASMTIME_STRATEGY_AUTO;
+		wasmtime_opt_level_t CraneliftOptLevel = WASMTIME_OPT_LEVEL_SPEED;
+		wasmtime_profiling_strategy_t Profiler = WASMTIME_PROFILING_STRATEGY_NONE;
+
+		bool bDebugInfo = false;
+		bool bInterruptable = false;
+		bool bConsumeFuel = false;
+		bool bCraneliftDebugVerifier = false;
+
+		bool bWasmThreads = false;
+		bool bWasmReferenceTypes = false;
+		bool bWasmSimd = false;
+		bool bWasmBulkMemory = false;
+		bool bWasmMultiValue = true;
+		bool bWasmModuleLinking = false;
+
+		int64 MaxWasmStack = INDEX_NONE;
+		int64 StaticMemoryMaximumSize = INDEX_NONE;
+		int64 StaticMemoryGuardSize = INDEX_NONE;
+		int64 DynamicMemoryGuardSize = INDEX_NONE;
+		int64 MaxInstances = INDEX_NONE;
+
+		static FWasmEngineSettings MakePreset(EWasmEnginePreset Preset);
+
+		/**
+		 * Reads a profile from ConfigFile, NAME_None reads the default profile. Missing sections yield the wasmtime defaults.
+		 */
+		static FWasmEngineSettings LoadFromConfig(const FName& Profile = NAME_None, const FString& ConfigFile = GEngineIni);
+
+		static bool LexPreset(const FString& String, EWasmEnginePreset& OutPreset);
+
+		/**
+		 * Builds a wasm_config_t with every setting applied.
+		 */
+		TWasmConfig MakeConfig() const;
+
+		/**
+		 * Stable description of every setting that affects generated code, used to key compiled module artifacts.
+		 */
+		FString GetConfigKey() const;
+
+		bool operator==(const FWasmEngineSettings& Other) const
+		{
+			return GetConfigKey() == Other.GetConfigKey();
+		}
+	};
+
+	FORCEINLINE TWasmEngine MakeWasmEngine(const FWasmEngineSettings& Settings)
+	{
+		return MakeWasmEngine(Settings.MakeConfig());
+	}
+
+	/**
+	 * Engine created from a settings profile, owned by FUEWasmTimeModule.
+	 */
+	struct UEWASMTIME_API FWasmEngineProfile
+	{
+		FName Name;
+		FWasmEngineSettings Settings;
+		/** Settings.GetConfigKey(), pass it along when compiling for Engine. */
+		FString ConfigKey;
+		TWasmEngine Engine;
+	};
+
+	/**
+	 * Shared engine of Profile, see FUEWasmTimeModule::GetEngineProfile. Asserts if the engine couldn't be created.
+	 */
+	UEWASMTIME_API const FWasmEngineProfile& GetSharedWasmEngineProfile(const FName& Profile = NAME_None);
+
+	FORCEINLINE const TWasmEngine& GetSharedWasmEngine(const FName& Profile = NAME_None)
+	{
+		return GetSharedWasmEngineProfile(Profile).Engine;
+	}
+}
@@ -0,0 +1,120 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UEWasmAPI.h"
+#include "UEWasmMemoryView.h"
+#include "UEWasmString.h"
+#include "UEWasmTypedFunc.h"
+
+namespace UEWas
+{
+	struct UEWASMTIME_API TWasmGuestHeapSettings
+	{
+		/** Guest export reserving memory, int32(int32 Size). */
+		FName AllocExport = TEXT("malloc");
+		/** Guest export releasing memory, void(int32 Pointer). Optional, without it arenas are never given back. */
+		FName FreeExport = TEXT("free");
+		/** Size of each arena reserved from the guest, larger allocations get an arena of their own. */
+		uint32 ArenaSize = 256 * 1024;
+		/** Rewinds the arenas on the first allocation of every frame. */
+		bool bResetEveryFrame = true;
+	};
+
+	struct UEWASMTIME_API TWasmGuestHeapStats
+	{
+		int32 NumArenas = 0;
+		uint64 BytesReserved = 0;
+		uint64 BytesUsed = 0;
+		/** Host side allocations since the last reset. */
+		uint32 NumAllocations = 0;
+		/** Calls into the guest allocator since binding. */
+		uint32 NumGuestCalls = 0;
+	};
+
+	/**
+	 * Host side allocator for marshaled arguments. Reserves large arenas from the guest allocator export in one call each and
+	 * sub-allocates from them, so passing strings and buffers costs roughly one guest call per frame instead of one per argument.
+	 *
+	 * Allocations live until the next Reset, which with bResetEveryFrame happens on the first allocation of a new frame.
+	 * The heap has to be used on the thread owning the context and must not outlive it.
+	 */
+	class UEWASMTIME_API TWasmGuestHeap
+	{
+	public:
+		TWasmGuestHeap() = default;
+
+		TWasmGuestHeap(const TWasmExecutionContext& InContext, const TWasmGuestHeapSettings& InSettings = {})
+		{
+			Bind(InContext, InSettings);
+		}
+
+		/**
+		 * Resolves the allocator exports of Context. Arenas of a previously bound context are dropped without freeing them.
+		 */
+		bool Bind(const TWasmExecutionContext& InContext, const TWasmGuestHeapSettings& InSettings = {});
+
+		FORCEINLINE bool IsBound() const
+		{
+			return Context != nullptr;
+		}
+
+		/**
+		 * @return Guest pointer to Size bytes aligned to Alignment, 0 if the guest allocator failed or the request can't fit the
+		 * guest's 32 bit allocator.
+		 */
+		uint32 Allocate(uint64 Size, uint32 Alignment = 8);
+
+		uint32 WriteString(const FString& String, bool bNullTerminate = true);
+
+		uint32 WriteLengthPrefixedString(const FString& String);
+
+		/**
+		 * Copies Data into the heap in one go.
+		 */
+		template <typename T>
+		uint32 WriteArray(TArrayView<const T> Data)
+		{
+			static_assert(TIsPODType<T>::Value, "Only plain old data can be copied into guest memory.");
+			const uint32 Pointer = Allocate(static_cast<uint64>(Data.Num()) * sizeof(T), alignof(T));
+			if (Pointer != 0)
+			{
+				MakeWasmMemoryView<T>(*Context, Pointer, Data.Num()).CopyFrom(Data);
+			}
+			return Pointer;
+		}
+
+		/**
+		 * Rewinds every arena, all pointers handed out so far become invalid. Arenas stay reserved.
+		 */
+		void Reset();
+
+		/**
+		 * Gives every arena back to the guest through the free export.
+		 */
+		void Release();
+
+		TWasmGuestHeapStats GetStats() const;
+
+	protected:
+		bool ReserveArena(uint32 MinSize);
+
+		struct TArena
+		{
+			uint32 Base = 0;
+			uint32 Size = 0;
+			uint32 Used = 0;
+		};
+
+		const TWasmExecutionContext* Context = nullptr;
+		TWasmGuestHeapSettings Settings;
+		TWasmAllocFunc AllocFunc;
+		TWasmTypedFunc<void(int32)> FreeFunc;
+
+		TArray<TArena, TInlineAllocator<4>> Arenas;
+		int32 CurrentArena = 0;
+		uint64 LastResetFrame = 0;
+		uint32 NumAllocations = 0;
+		uint32 NumGuestCalls = 0;
+	};
+}
@@ -0,0 +1,80 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	class TWasmContextPool;
+
+	struct UEWASMTIME_API TWasmMemoryAccountingStats
+	{
+		TWasmMemoryUsage Total;
+		uint64 PeakBytes = 0;
+		int32 NumContexts = 0;
+		/** Idle pooled contexts destroyed to stay within the global budget. */
+		uint64 Evictions = 0;
+		/** Contexts refused at instantiation because they didn't fit a budget. */
+		uint64 Rejections = 0;
+	};
+
+	/**
+	 * Memory used by every live TWasmExecutionContext, reported by the contexts themselves on instantiation and whenever their memory
+	 * grows, so the numbers never touch a store from another thread.
+	 *
+	 * Budgets come from the wasm.Memory.* console variables, 0 disables them. Running out of the global budget evicts idle contexts
+	 * of registered pools, least recently released first, and refuses new contexts when nothing is left to evict. A context over
+	 * its own budget can't be stopped from growing, it's reported instead.
+	 */
+	class UEWASMTIME_API TWasmMemoryAccounting
+	{
+	public:
+		static TWasmMemoryAccounting& Get();
+
+		/**
+		 * Starts accounting Context, making room for it first.
+		 * @return False if it doesn't fit the budgets, the context isn't accounted then.
+		 */
+		bool AddContext(const TWasmExecutionContext* Context, const TWasmMemoryUsage& Usage, FString& OutError);
+		void UpdateContext(const TWasmExecutionContext* Context, const TWasmMemoryUsage& Usage);
+		void RemoveContext(const TWasmExecutionContext* Context);
+
+		bool FindContextUsage(const TWasmExecutionContext* Context, TWasmMemoryUsage& OutUsage) const;
+		TWasmMemoryAccountingStats GetStats() const;
+
+		/**
+		 * Lets the pool's idle contexts be evicted. Pools register themselves on creation and drop out when destroyed.
+		 */
+		void AddEvictionSource(const TWeakPtr<TWasmContextPool, ESPMode::ThreadSafe>& Pool);
+
+		/**
+		 * Evicts idle pooled contexts, least recently released first, until Bytes more fit the global budget.
+		 */
+		bool MakeRoom(uint64 Bytes);
+
+		static uint64 GetGlobalBudget();
+		static uint64 GetContextBudget();
+		/** Estimated bytes a store, its WASI instance and linker take besides memories and tables. */
+		static uint64 GetStoreOverhead();
+
+	protected:
+		/**
+		 * MakeRoom, with bReserve the room is claimed as pending under the same lock that found it, so concurrent AddContext calls
+		 * can't all pass the check and overshoot the budget. AddContext turns the reservation into the context's usage.
+		 */
+		bool EvictUntilFits(uint64 Bytes, bool bReserve);
+		void UpdateStats() const;
+
+		mutable FCriticalSection Lock;
+		TMap<const TWasmExecutionContext*, TWasmMemoryUsage> Contexts;
+		TWasmMemoryUsage Total;
+		/** Bytes claimed by AddContext calls that made room but haven't been accounted yet. */
+		uint64 PendingBytes = 0;
+		uint64 PeakBytes = 0;
+		uint64 Evictions = 0;
+		uint64 Rejections = 0;
+		TArray<TWeakPtr<TWasmContextPool, ESPMode::ThreadSafe>> EvictionSources;
+	};
+}
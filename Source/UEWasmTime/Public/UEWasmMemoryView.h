@@ -0,0 +1,174 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	/**
+	 * Bounds checked window of Num elements at Offset in a context's linear memory. It holds the raw pointer, so accesses and bulk
+	 * copies are plain memory operations without export lookups.
+	 *
+	 * memory.grow may move the memory. Views remember the growth epoch they were made in, IsStale tells whether the memory moved
+	 * or resized since, Refresh rebuilds the view at the same offset. Views have to be used on the thread owning the context.
+	 */
+	template <typename T>
+	class TWasmMemoryView
+	{
+		static_assert(TIsPODType<T>::Value, "Guest memory can only be viewed as plain old data.");
+
+	public:
+		TWasmMemoryView() = default;
+
+		/**
+		 * Empty if the range isn't inside the memory or the module doesn't export one.
+		 */
+		TWasmMemoryView(const TWasmExecutionContext& InContext, uint64 InOffset, uint64 InNum)
+			: Context(&InContext), Offset(InOffset), Num(InNum)
+		{
+			Refresh();
+		}
+
+		/**
+		 * Re-resolves the view against the current memory, needed once IsStale.
+		 */
+		bool Refresh()
+		{
+			Data = nullptr;
+			if (!Context)
+			{
+				return false;
+			}
+
+			Epoch = Context->GetMemoryEpoch();
+			const uint64 MemorySize = Context->GetCachedMemorySize();
+			// Division instead of multiplication so huge counts can't overflow past the check.
+			if (Offset <= MemorySize && Num <= (MemorySize - Offset) / sizeof(T) && Context->GetCachedMemoryData())
+			{
+				Data = reinterpret_cast<T*>(Context->GetCachedMemoryData() + Offset);
+			}
+			return Data != nullptr;
+		}
+
+		FORCEINLINE bool IsValid() const
+		{
+			return Data != nullptr;
+		}
+
+		FORCEINLINE bool IsStale() const
+		{
+			return !Context || Context->GetMemoryEpoch() != Epoch;
+		}
+
+		FORCEINLINE uint32 GetEpoch() const
+		{
+			return Epoch;
+		}
+
+		FORCEINLINE uint64 GetOffset() const
+		{
+			return Offset;
+		}
+
+		FORCEINLINE uint64 GetNum() const
+		{
+			return Num;
+		}
+
+		FORCEINLINE T* GetData() const
+		{
+			return Data;
+		}
+
+		/**
+		 * Element access. Guest pointers can be unaligned, prefer Read and Write unless the guest guarantees alignment.
+		 */
+		FORCEINLINE T& operator[](uint64 Index) const
+		{
+			checkf(Data && Index < Num, TEXT("Wasm memory view index %llu out of bounds (%llu)."), Index, Num);
+			checkSlow(IsAligned(Data + Index, alignof(T)));
+			return Data[Index];
+		}
+
+		FORCEINLINE T Read(uint64 Index) const
+		{
+			checkf(Data && Index < Num, TEXT("Wasm memory view index %llu out of bounds (%llu)."), Index, Num);
+			T Value;
+			FMemory::Memcpy(&Value, Data + Index, sizeof(T));
+			return Value;
+		}
+
+		FORCEINLINE void Write(uint64 Index, const T& Value) const
+		{
+			checkf(Data && Index < Num, TEXT("Wasm memory view index %llu out of bounds (%llu)."), Index, Num);
+			FMemory::Memcpy(Data + Index, &Value, sizeof(T));
+		}
+
+		/**
+		 * Copies min(Num, Out.Num()) elements out of guest memory, returns how many.
+		 */
+		uint64 CopyTo(TArrayView<T> Out) const
+		{
+			const uint64 NumToCopy = Data ? FMath::Min<uint64>(Num, Out.Num()) : 0;
+			FMemory::Memcpy(Out.GetData(), Data, NumToCopy * sizeof(T));
+			return NumToCopy;
+		}
+
+		/**
+		 * Copies min(Num, In.Num()) elements into guest memory, returns how many.
+		 */
+		uint64 CopyFrom(TArrayView<const T> In) const
+		{
+			const uint64 NumToCopy = Data ? FMath::Min<uint64>(Num, In.Num()) : 0;
+			FMemory::Memcpy(Data, In.GetData(), NumToCopy * sizeof(T));
+			return NumToCopy;
+		}
+
+		/**
+		 * The view as a TArrayView, valid until the memory grows. Views larger than TArrayView can address are clamped.
+		 */
+		FORCEINLINE TArrayView<T> AsArrayView() const
+		{
+			return TArrayView<T>(Data, Data ? static_cast<int32>(FMath::Min<uint64>(Num, MAX_int32)) : 0);
+		}
+
+		/**
+		 * Reinterprets a sub range in elements of another type, e.g. a struct inside a byte view. Empty if it leaves the view.
+		 */
+		template <typename OtherType>
+		TWasmMemoryView<OtherType> Slice(uint64 ByteOffset, uint64 InNum) const
+		{
+			const uint64 ViewSize = Num * sizeof(T);
+			if (!Data || ByteOffset > ViewSize || InNum > (ViewSize - ByteOffset) / sizeof(OtherType))
+			{
+				return {};
+			}
+			return TWasmMemoryView<OtherType>(*Context, Offset + ByteOffset, InNum);
+		}
+
+	private:
+		const TWasmExecutionContext* Context = nullptr;
+		T* Data = nullptr;
+		uint64 Offset = 0;
+		uint64 Num = 0;
+		uint32 Epoch = 0;
+	};
+
+	typedef TWasmMemoryView<uint8> TWasmByteView;
+
+	template <typename T>
+	FORCEINLINE TWasmMemoryView<T> MakeWasmMemoryView(const TWasmExecutionContext& Context, uint64 Offset, uint64 Num)
+	{
+		return TWasmMemoryView<T>(Context, Offset, Num);
+	}
+
+	/**
+	 * View of the whole memory.
+	 */
+	FORCEINLINE TWasmByteView MakeWasmMemoryView(const TWasmExecutionContext& Context)
+	{
+		Context.GetMemoryEpoch();
+		return TWasmByteView(Context, 0, Context.GetCachedMemorySize());
+	}
+}
@@ -0,0 +1,79 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include <atomic>
+#include "CoreMinimal.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	struct UEWASMTIME_API TWasmModuleCacheStats
+	{
+		/** Modules loaded from a cached artifact without compiling. */
+		uint64 Hits = 0;
+		/** Modules that had to be compiled. */
+		uint64 Misses = 0;
+		/** Artifacts written to disk. */
+		uint64 Writes = 0;
+		/** Artifacts found on disk but refused by wasmtime, e.g. corrupt or written by another build. */
+		uint64 Rejected = 0;
+	};
+
+	/**
+	 * Content addressed, on-disk cache of compiled module artifacts.
+	 * Keys hash the wasm binary together with the engine configuration and the wasmtime version, a hit deserializes the stored
+	 * native code and skips compilation completely.
+	 */
+	class UEWASMTIME_API TWasmModuleCache
+	{
+	public:
+		explicit TWasmModuleCache(const FString& InCacheDirectory);
+
+		/**
+		 * Process wide cache stored under Saved/WasmModuleCache.
+		 */
+		static TWasmModuleCache& Get();
+
+		/**
+		 * @param EngineConfigKey Identifies the engine configuration the module is compiled with, the ConfigKey of the engine's
+		 * profile. Artifacts are only valid for the configuration they were produced with.
+		 */
+		FString MakeKey(const TWasmByteVec& Binary, const FString& EngineConfigKey) const;
+
+		/**
+		 * Loads the module from the cache, or compiles it and stores the artifact for the next lookup.
+		 */
+		TWasmModule FindOrCompile(const TWasmEngine& Engine, const TWasmByteVec& Binary, FString& OutErrorString,
+		                          const FString& EngineConfigKey);
+
+		TWasmModule Find(const TWasmEngine& Engine, const FString& Key);
+		bool Add(const FString& Key, const TWasmModule& Module);
+		void Remove(const FString& Key);
+
+		TWasmModuleCacheStats GetStats() const;
+		void ResetStats();
+
+		FORCEINLINE const FString& GetCacheDirectory() const
+		{
+			return CacheDirectory;
+		}
+
+	protected:
+		FString GetArtifactPath(const FString& Key) const;
+
+		FString CacheDirectory;
+		std::atomic<uint64> Hits;
+		std::atomic<uint64> Misses;
+		std::atomic<uint64> Writes;
+		std::atomic<uint64> Rejected;
+	};
+
+	/**
+	 * MakeWasmModule going through the process wide module cache.
+	 */
+	FORCEINLINE TWasmModule MakeWasmModuleCached(const TWasmEngine& Engine, const TWasmByteVec& Binary, FString& OutErrorString,
+	                                             const FString& EngineConfigKey)
+	{
+		return TWasmModuleCache::Get().FindOrCompile(Engine, Binary, OutErrorString, EngineConfigKey);
+	}
+}
@@ -0,0 +1,80 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	/**
+	 * Module interned by TWasmModuleRegistry. Immutable once registered, so it can be used from any thread.
+	 */
+	struct UEWASMTIME_API TWasmModuleEntry
+	{
+		FString Key;
+		/** Engine the module was compiled with, only stores of this engine can obtain it. */
+		const wasm_engine_t* Engine = nullptr;
+		TWasmSharedModule SharedModule;
+		TWasmItemMap ExternMap;
+		TWasmItemMap ImportMap;
+
+		/**
+		 * Obtains the module for Store without compiling it again. Store has to belong to the engine the module was registered with.
+		 */
+		FORCEINLINE TWasmModule Obtain(const TWasmStore& Store) const
+		{
+			return WasmModuleObtain(Store, SharedModule);
+		}
+
+		/** Contexts get their own copies, TWasmItemMapPtr isn't thread safe. */
+		FORCEINLINE TWasmItemMapPtr MakeExternMapping() const
+		{
+			return MakeShared<TWasmItemMap>(ExternMap);
+		}
+
+		FORCEINLINE TWasmItemMapPtr MakeImportMapping() const
+		{
+			return MakeShared<TWasmItemMap>(ImportMap);
+		}
+	};
+
+	/**
+	 * Process wide table of compiled modules interned by content hash, so every context instantiating the same bytes shares one
+	 * compiled copy. Entries are released once the last handle goes away.
+	 *
+	 * Compiled code belongs to one engine. Profiles with identical settings share a config key but not an engine, so entries are
+	 * keyed by engine and content key together.
+	 */
+	class UEWASMTIME_API TWasmModuleRegistry
+	{
+	public:
+		static TWasmModuleRegistry& Get();
+
+		/**
+		 * Returns the interned module for Binary, compiling it through the module cache the first time it is seen.
+		 * Entries are per engine configuration, EngineConfigKey has to be the ConfigKey of Engine's profile.
+		 */
+		TWasmModuleHandle FindOrAdd(const TWasmEngine& Engine, const TWasmByteVec& Binary, FString& OutErrorString,
+		                            const FString& EngineConfigKey);
+
+		/**
+		 * Interns an already compiled module, e.g. one loaded from a UWasmModuleAsset. Module has to be compiled by Engine.
+		 * Returns the existing entry if Key is taken for Engine.
+		 */
+		TWasmModuleHandle Add(const TWasmEngine& Engine, const FString& Key, const TWasmModule& Module);
+
+		TWasmModuleHandle Find(const TWasmEngine& Engine, const FString& Key) const;
+
+		/** Number of modules with live handles. */
+		int32 Num() const;
+
+	protected:
+		void RemoveStaleEntries();
+
+		mutable FCriticalSection Lock;
+		/** An entry keeps its engine alive, so the address can't be reused while the entry can still be pinned. */
+		typedef TPair<const wasm_engine_t*, FString> FEntryKey;
+		TMap<FEntryKey, TWeakPtr<const TWasmModuleEntry, ESPMode::ThreadSafe>> Modules;
+	};
+}
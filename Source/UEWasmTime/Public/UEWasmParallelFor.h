@@ -0,0 +1,71 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UEWasmRuntime.h"
+#include "UEWasmTypedFunc.h"
+
+namespace UEWas
+{
+	/**
+	 * Export taking a (Begin, End) range, instantiated once on every worker of an FWasmRuntime from the same shared module.
+	 * Run splits a range into chunks the replicas claim one at a time until none are left, so faster workers take more of them.
+	 *
+	 * Replicas don't share memory, each chunk has to read its inputs and publish its outputs through the host or its own instance.
+	 * The runtime has to outlive the kernel.
+	 */
+	class UEWASMTIME_API FWasmParallelKernel
+	{
+	public:
+		typedef TWasmTypedFunc<void(int32, int32)> TKernelFunc;
+
+		/**
+		 * Instantiates the replicas and binds ExportName on each of them, blocking until they are ready.
+		 */
+		FWasmParallelKernel(FWasmRuntime& InRuntime, const TWasmModuleHandle& Module, const FWasmEngineProfilePtr& EngineProfile,
+		                    const FName& InExportName, const TArray<TWasmFunctionSignaturePtr>& HostFunctions = {},
+		                    const FString& WorkspacePath = TEXT(""));
+		~FWasmParallelKernel();
+
+		FWasmParallelKernel(const FWasmParallelKernel&) = delete;
+		FWasmParallelKernel& operator=(const FWasmParallelKernel&) = delete;
+
+		/**
+		 * Calls the export for every chunk of [Begin, End) of at most Grain items and waits for all of them. A trapping chunk stops
+		 * the replica it ran on, the others finish the remaining chunks.
+		 * Must not be called from a worker of the runtime.
+		 * @return False if any chunk trapped.
+		 */
+		bool Run(int32 Begin, int32 End, int32 Grain);
+
+		FORCEINLINE bool IsValid() const
+		{
+			return bValid;
+		}
+
+		FORCEINLINE int32 GetNumReplicas() const
+		{
+			return Replicas.Num();
+		}
+
+	protected:
+		struct FReplica
+		{
+			FWasmRuntimeContextHandle Handle;
+			/** Bound and called on the replica's worker only. */
+			TKernelFunc Func;
+		};
+
+		FWasmRuntime& Runtime;
+		FName ExportName;
+		/** Never resized after construction, tasks point into it. */
+		TArray<FReplica> Replicas;
+		bool bValid = false;
+	};
+
+	/**
+	 * One off FWasmParallelKernel::Run, the replicas are instantiated for this call only. Keep a kernel around for repeated runs.
+	 */
+	UEWASMTIME_API bool WasmParallelFor(FWasmRuntime& Runtime, const TWasmModuleHandle& Module, const FWasmEngineProfilePtr& EngineProfile,
+	                                    const FName& ExportName, int32 Begin, int32 End, int32 Grain);
+}
@@ -0,0 +1,31 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	struct UEWASMTIME_API TWasmPreInitOptions
+	{
+		/** Export building the initial state, it has to take and return nothing. WASI reactors get their _initialize run first. */
+		FString InitExport = TEXT("wizer.initialize");
+		/** Keeps the init exports in the output, by default they're removed so the state can't be initialized twice. */
+		bool bKeepInitExport = false;
+		/** Host functions the module imports, linked like at runtime. */
+		TArray<TWasmFunctionSignaturePtr> HostFunctions;
+		/** Directory preopened for WASI while initializing, defaults to the project saved directory. */
+		FString WorkspacePath;
+	};
+
+	/**
+	 * Instantiates Binary, runs its init export and writes a module whose data segments and global initializers already hold the
+	 * resulting state, so instantiating it skips initialization. The start section is dropped, it already ran.
+	 *
+	 * Only state inside the module is captured: modules importing their memory, using passive data segments or keeping reference
+	 * values in mutable globals are rejected. Tables and host side state (WASI file descriptors, host function environments) have
+	 * to be left alone by the init export.
+	 */
+	UEWASMTIME_API bool WasmPreInitialize(const TWasmEngine& Engine, const TArray<uint8>& Binary, const TWasmPreInitOptions& Options,
+	                                      TArray<uint8>& OutBinary, FString& OutErrorString);
+}
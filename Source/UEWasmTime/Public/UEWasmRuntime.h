@@ -0,0 +1,128 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include <atomic>
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "UEWasmAPI.h"
+#include "UEWasmEngineSettings.h"
+
+namespace UEWas
+{
+	class FWasmRuntimeWorker;
+
+	/**
+	 * Context owned by a worker of an FWasmRuntime.
+	 */
+	struct UEWASMTIME_API FWasmRuntimeContextHandle
+	{
+		int32 Worker = INDEX_NONE;
+		uint32 Id = 0;
+
+		FORCEINLINE bool IsValid() const
+		{
+			return Worker != INDEX_NONE;
+		}
+	};
+
+	struct UEWASMTIME_API FWasmRuntimeCallResult
+	{
+		bool bSuccess = false;
+		TArray<wasm_val_t> Results;
+		FString Error;
+	};
+
+	/**
+	 * Runs wasm on a fixed set of worker threads. Every context belongs to one worker and is only ever created, called and destroyed
+	 * on that worker's thread, which is what wasmtime's single threaded stores require. Work is routed to the owning worker through
+	 * a lock free multi producer queue and results come back as futures, callers never block unless they wait on one.
+	 *
+	 * Destroying the runtime runs the tasks queued so far, then destroys the remaining contexts on their workers. Nothing may be
+	 * queued once destruction started.
+	 */
+	class UEWASMTIME_API FWasmRuntime
+	{
+	public:
+		/**
+		 * @param NumWorkers 0 spawns as many workers as the platform recommends for worker threads.
+		 */
+		explicit FWasmRuntime(int32 NumWorkers = 0, const FString& Name = TEXT("WasmRuntime"), EThreadPriority Priority = TPri_Normal);
+		~FWasmRuntime();
+
+		FWasmRuntime(const FWasmRuntime&) = delete;
+		FWasmRuntime& operator=(const FWasmRuntime&) = delete;
+
+		/**
+		 * Instantiates Module on Worker, or on the least busy worker. The future holds an invalid handle if instantiation failed.
+		 */
+		TFuture<FWasmRuntimeContextHandle> CreateContext(const TWasmModuleHandle& Module, const FWasmEngineProfilePtr& EngineProfile,
+		                                                 const TArray<TWasmFunctionSignaturePtr>& HostFunctions, const FString& WorkspacePath,
+		                                                 int32 Worker = INDEX_NONE);
+
+		/**
+		 * Hands a context created elsewhere, e.g. by a TWasmContextPool, to a worker. Nothing else may touch it afterwards.
+		 */
+		TFuture<FWasmRuntimeContextHandle> AddContext(TWasmExecutionContextPtr&& Context, int32 Worker = INDEX_NONE);
+
+		TFuture<bool> DestroyContext(const FWasmRuntimeContextHandle& Handle);
+
+		/**
+		 * Runs Function(TWasmExecutionContext&) on the worker owning Handle, the context must not escape it. If the context
+		 * doesn't exist Function isn't run and the future holds a default constructed result.
+		 */
+		template <typename FunctionType>
+		auto Execute(const FWasmRuntimeContextHandle& Handle, FunctionType&& Function) -> TFuture<decltype(Function(DeclVal<TWasmExecutionContext&>()))>
+		{
+			typedef decltype(Function(DeclVal<TWasmExecutionContext&>())) TResult;
+
+			TPromise<TResult> Promise;
+			TFuture<TResult> Future = Promise.GetFuture();
+			EnqueueContextTask(Handle, [Promise = MoveTemp(Promise), Function = Forward<FunctionType>(Function)](TWasmExecutionContext* Context) mutable
+			{
+				if constexpr (TIsSame<TResult, void>::Value)
+				{
+					if (Context)
+					{
+						Function(*Context);
+					}
+					Promise.SetValue();
+				}
+				else
+				{
+					Promise.SetValue(Context ? Function(*Context) : TResult());
+				}
+			});
+			return Future;
+		}
+
+		/**
+		 * Calls an export by name with untyped arguments on the worker owning Handle.
+		 */
+		TFuture<FWasmRuntimeCallResult> Call(const FWasmRuntimeContextHandle& Handle, const FName& ExportName, TArray<wasm_val_t> Args);
+
+		/**
+		 * Runs Task on Worker outside of any context.
+		 */
+		void EnqueueTask(int32 Worker, TUniqueFunction<void()>&& Task);
+
+		FORCEINLINE int32 GetNumWorkers() const
+		{
+			return Workers.Num();
+		}
+
+		/**
+		 * Index of the worker running the calling thread, INDEX_NONE if it isn't one of this runtime's.
+		 */
+		int32 GetCurrentWorker() const;
+
+	protected:
+		/**
+		 * Runs Task on the worker owning Handle with its context, or nullptr if it doesn't exist.
+		 */
+		void EnqueueContextTask(const FWasmRuntimeContextHandle& Handle, TUniqueFunction<void(TWasmExecutionContext*)>&& Task);
+		int32 PickWorker() const;
+
+		TArray<TUniquePtr<FWasmRuntimeWorker>> Workers;
+		std::atomic<uint32> NextContextId;
+	};
+}
@@ -0,0 +1,91 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	struct UEWASMTIME_API TWasmSharedMemorySettings
+	{
+		uint32 MinimumPages = 1;
+		/** 0 lets the memory grow to 4GiB. */
+		uint32 MaximumPages = 0;
+		/** Import the member modules declare for the memory. */
+		FString ImportModule = TEXT("env");
+		FString ImportName = TEXT("memory");
+	};
+
+	/**
+	 * One linear memory imported by several contexts, e.g. kernels each working on a partition of the same dataset without copying
+	 * it between instances. The memory is defined once and linked into every member context with wasmtime_linker_define.
+	 *
+	 * Wasmtime 0.26 ties a memory to the store it was created in and a store to one thread at a time, so the members share the
+	 * group's store and run one after another on whichever thread owns the group. The engine's threads proposal only enables
+	 * atomics, shared memories can't be created through this C API: members have to import a plain, non shared memory.
+	 * The memory isn't part of any member's memory accounting.
+	 */
+	class UEWASMTIME_API TWasmSharedMemoryGroup : public TSharedFromThis<TWasmSharedMemoryGroup, ESPMode::ThreadSafe>
+	{
+	public:
+		TWasmSharedMemoryGroup(const TWasmEngine& InEngine, const TWasmSharedMemorySettings& InSettings);
+
+		static TSharedRef<TWasmSharedMemoryGroup, ESPMode::ThreadSafe> Create(const TWasmEngine& InEngine,
+		                                                                      const TWasmSharedMemorySettings& InSettings = {});
+
+		/**
+		 * Instantiates Module into the group. It has to be registered with the engine the group was created with.
+		 */
+		TWasmExecutionContextPtr CreateContext(const TWasmModuleHandle& Module, const TArray<TWasmFunctionSignaturePtr>& HostFunctions,
+		                                       const FString& WorkspacePath);
+
+		/**
+		 * Satisfies the memory import of modules instantiated through Linker, which has to belong to the group's store.
+		 */
+		bool DefineMemory(const TWasmLinker& Linker, FString& OutError) const;
+
+		FORCEINLINE bool IsValid() const
+		{
+			return Memory.IsValid();
+		}
+
+		FORCEINLINE const FString& GetError() const
+		{
+			return Error;
+		}
+
+		FORCEINLINE wasm_store_t* GetStore() const
+		{
+			return Store.Get();
+		}
+
+		FORCEINLINE wasm_memory_t* GetMemory() const
+		{
+			return Memory.Get();
+		}
+
+		/**
+		 * Base of the memory. Host threads may work on it while no member is running, growing moves it.
+		 */
+		FORCEINLINE uint8* GetMemoryData() const
+		{
+			return Memory.IsValid() ? reinterpret_cast<uint8*>(wasm_memory_data(Memory.Get())) : nullptr;
+		}
+
+		FORCEINLINE uint64 GetMemorySize() const
+		{
+			return Memory.IsValid() ? wasm_memory_data_size(Memory.Get()) : 0;
+		}
+
+	protected:
+		TWasmSharedMemorySettings Settings;
+		/** Declared before Memory, which has to be released first. */
+		TWasmStore Store;
+		TWasmMemory Memory;
+		TWasmName ImportModule;
+		TWasmName ImportName;
+		FString Error;
+	};
+
+	typedef TSharedPtr<TWasmSharedMemoryGroup, ESPMode::ThreadSafe> TWasmSharedMemoryGroupPtr;
+}
@@ -0,0 +1,82 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UEWasmAPI.h"
+#include "UEWasmTypedFunc.h"
+
+namespace UEWas
+{
+	/**
+	 * Guest allocator export, e.g. malloc. Takes a size in bytes and returns a guest pointer, 0 on failure.
+	 */
+	typedef TWasmTypedFunc<int32(int32)> TWasmAllocFunc;
+
+	/**
+	 * Index of the first NUL in Data, or NumBytes if there is none. Scans 16 bytes at a time where SSE2 is available.
+	 */
+	UEWASMTIME_API SIZE_T WasmFindNul(const uint8* Data, SIZE_T NumBytes);
+
+	/**
+	 * Decodes NumBytes of UTF-8. ASCII runs are widened 16 bytes at a time, the rest goes through the engine's UTF-8 decoder.
+	 */
+	UEWASMTIME_API FString WasmDecodeUtf8(const uint8* Data, SIZE_T NumBytes);
+
+	/**
+	 * Number of bytes Chars takes as UTF-8, without terminator.
+	 */
+	UEWASMTIME_API SIZE_T WasmUtf8Length(const TCHAR* Chars, int32 NumChars);
+
+	/**
+	 * Encodes Chars as UTF-8 into Out, which has to hold WasmUtf8Length bytes. Returns the number of bytes written.
+	 */
+	UEWASMTIME_API SIZE_T WasmEncodeUtf8(const TCHAR* Chars, int32 NumChars, uint8* Out, SIZE_T OutCapacity);
+
+	/**
+	 * Reads a NUL terminated string at Offset, at most MaxBytes are scanned. Empty if Offset is outside the memory.
+	 */
+	UEWASMTIME_API FString WasmMemoryReadString(const TWasmExecutionContext& Context, uint64 Offset, uint64 MaxBytes = MAX_uint64);
+
+	/**
+	 * Reads exactly NumBytes at Offset, nothing is scanned. Empty if the range is outside the memory.
+	 */
+	UEWASMTIME_API FString WasmMemoryReadStringWithLength(const TWasmExecutionContext& Context, uint64 Offset, uint64 NumBytes);
+
+	/**
+	 * Reads a length prefixed string: a little endian uint32 byte count at Offset followed by the UTF-8 bytes.
+	 */
+	UEWASMTIME_API FString WasmMemoryReadLengthPrefixedString(const TWasmExecutionContext& Context, uint64 Offset);
+
+	/**
+	 * Writes String as UTF-8 into Capacity bytes at Offset, NUL terminated if bNullTerminate.
+	 * @return Bytes written including the terminator, INDEX_NONE if it doesn't fit.
+	 */
+	UEWASMTIME_API int64 WasmMemoryWriteStringAt(const TWasmExecutionContext& Context, uint64 Offset, uint64 Capacity, const FString& String,
+	                                             bool bNullTerminate = true);
+
+	/**
+	 * Allocates guest memory through Alloc and writes String into it.
+	 * @return Guest pointer to the string, 0 if the allocation failed.
+	 */
+	UEWASMTIME_API uint32 WasmMemoryWriteString(const TWasmExecutionContext& Context, const TWasmAllocFunc& Alloc, const FString& String,
+	                                            bool bNullTerminate = true);
+
+	/**
+	 * Writes String in the length prefixed layout read by WasmMemoryReadLengthPrefixedString into Capacity bytes at Offset.
+	 * @return Bytes written, INDEX_NONE if it doesn't fit.
+	 */
+	UEWASMTIME_API int64 WasmMemoryWriteLengthPrefixedStringAt(const TWasmExecutionContext& Context, uint64 Offset, uint64 Capacity,
+	                                                           const FString& String);
+
+	/**
+	 * Allocates guest memory through Alloc and writes String length prefixed into it.
+	 * @return Guest pointer to the length prefix, 0 if the allocation failed.
+	 */
+	UEWASMTIME_API uint32 WasmMemoryWriteLengthPrefixedString(const TWasmExecutionContext& Context, const TWasmAllocFunc& Alloc,
+	                                                          const FString& String);
+
+	FORCEINLINE uint64 WasmLengthPrefixedStringSize(const FString& String)
+	{
+		return sizeof(uint32) + WasmUtf8Length(*String, String.Len());
+	}
+}
@@ -0,0 +1,106 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/Class.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	/**
+	 * Bytes copied verbatim between a host struct and its guest layout, adjacent fields are merged into one run.
+	 */
+	struct UEWASMTIME_API TWasmStructRun
+	{
+		uint32 HostOffset = 0;
+		uint32 GuestOffset = 0;
+		uint32 Size = 0;
+	};
+
+	/**
+	 * Layout a C compiler targeting wasm32 gives a UScriptStruct: every member at its natural alignment, in declaration order.
+	 * A super struct comes first and is laid out like a nested struct member.
+	 * Numeric, enum, native bool and nested struct properties including static arrays are supported.
+	 */
+	struct UEWASMTIME_API TWasmStructLayout
+	{
+		const UScriptStruct* Struct = nullptr;
+		uint32 HostSize = 0;
+		uint32 GuestSize = 0;
+		uint32 GuestAlignment = 1;
+		TArray<TWasmStructRun> Runs;
+		/** Every field sits at the same offset on both sides and the sizes match, instances and arrays copy with one memcpy. */
+		bool bMatchesHost = false;
+		bool bValid = false;
+		FString Error;
+	};
+
+	typedef TSharedPtr<const TWasmStructLayout, ESPMode::ThreadSafe> TWasmStructLayoutPtr;
+
+	/**
+	 * Guest layouts computed once per struct type and shared by every context. Entries are keyed weakly, a struct that was
+	 * garbage collected or replaced by a reload gets a fresh layout.
+	 */
+	class UEWASMTIME_API TWasmStructLayoutCache
+	{
+	public:
+		static TWasmStructLayoutCache& Get();
+
+		TWasmStructLayoutPtr FindOrAdd(const UScriptStruct* Struct);
+
+		/** Drops every layout, e.g. after structs were reloaded. */
+		void Reset();
+
+	protected:
+		static void BuildLayout(const UScriptStruct* Struct, TWasmStructLayout& OutLayout);
+
+		FRWLock Lock;
+		TMap<TWeakObjectPtr<const UScriptStruct>, TWasmStructLayoutPtr> Layouts;
+	};
+
+	/**
+	 * Copies Num instances of Struct from Data into guest memory at GuestOffset, laid out back to back with the guest stride.
+	 */
+	UEWASMTIME_API bool WasmWriteStructArray(const TWasmExecutionContext& Context, uint64 GuestOffset, const UScriptStruct* Struct,
+	                                         const void* Data, int32 Num);
+
+	/**
+	 * Copies Num instances of Struct from guest memory at GuestOffset into Data.
+	 */
+	UEWASMTIME_API bool WasmReadStructArray(const TWasmExecutionContext& Context, uint64 GuestOffset, const UScriptStruct* Struct,
+	                                        void* Data, int32 Num);
+
+	template <typename T>
+	FORCEINLINE bool WasmWriteStruct(const TWasmExecutionContext& Context, uint64 GuestOffset, const T& Value)
+	{
+		return WasmWriteStructArray(Context, GuestOffset, TBaseStructure<T>::Get(), &Value, 1);
+	}
+
+	template <typename T>
+	FORCEINLINE bool WasmReadStruct(const TWasmExecutionContext& Context, uint64 GuestOffset, T& OutValue)
+	{
+		return WasmReadStructArray(Context, GuestOffset, TBaseStructure<T>::Get(), &OutValue, 1);
+	}
+
+	template <typename T>
+	FORCEINLINE bool WasmWriteStructArray(const TWasmExecutionContext& Context, uint64 GuestOffset, TArrayView<const T> Values)
+	{
+		return WasmWriteStructArray(Context, GuestOffset, TBaseStructure<T>::Get(), Values.GetData(), Values.Num());
+	}
+
+	template <typename T>
+	FORCEINLINE bool WasmReadStructArray(const TWasmExecutionContext& Context, uint64 GuestOffset, TArrayView<T> OutValues)
+	{
+		return WasmReadStructArray(Context, GuestOffset, TBaseStructure<T>::Get(), OutValues.GetData(), OutValues.Num());
+	}
+
+	/**
+	 * Bytes Num instances of T take in guest memory, what has to be allocated before writing them.
+	 */
+	template <typename T>
+	FORCEINLINE uint64 WasmStructArraySize(int32 Num)
+	{
+		const TWasmStructLayoutPtr Layout = TWasmStructLayoutCache::Get().FindOrAdd(TBaseStructure<T>::Get());
+		return Layout->bValid ? static_cast<uint64>(Layout->GuestSize) * Num : 0;
+	}
+}
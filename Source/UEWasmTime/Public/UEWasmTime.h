@@ -1,6 +1,17 @@
 #pragma once
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Modules/ModuleInterface.h"
 
 UEWASMTIME_API DECLARE_LOG_CATEGORY_EXTERN(LogUEWasmTime, Log, All);
+DECLARE_STATS_GROUP(TEXT("UEWasmTime"), STATGROUP_UEWasmTime, STATCAT_Advanced);
+
+namespace UEWas
+{
+	struct FWasmEngineProfile;
+}
+
+typedef TSharedPtr<const UEWas::FWasmEngineProfile, ESPMode::ThreadSafe> FWasmEngineProfilePtr;
 
 class UEWASMTIME_API FUEWasmTimeModule : public IModuleInterface
 {
@@ -10,7 +21,19 @@ public:
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
 
+	static FUEWasmTimeModule& Get();
+
+	/**
+	 * Engine shared by everything using the settings Profile, NAME_None is the default profile. Sharing one engine shares
+	 * compiled code between all contexts. Profiles are created on first use, the module loads before config is read so
+	 * none may be requested during startup.
+	 */
+	FWasmEngineProfilePtr GetEngineProfile(const FName& Profile = NAME_None);
+
 private:
 	/** Handle to the test dll we will load */
-	void*	WasmTimeHandle;
+	void*	WasmTimeHandle = nullptr;
+
+	FCriticalSection EngineProfilesLock;
+	TMap<FName, FWasmEngineProfilePtr> EngineProfiles;
 };
@@ -0,0 +1,187 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Templates/Tuple.h"
+#include "UEWasmAPI.h"
+
+namespace UEWas
+{
+	/**
+	 * Checks the parameter and result kinds of Func against the given ones.
+	 */
+	UEWASMTIME_API bool WasmFuncTypeMatches(const wasm_func_t* Func, const wasm_valkind_t* ArgKinds, uint32 NumArgs, const wasm_valkind_t* ResultKinds,
+	                                        uint32 NumResults);
+
+	/**
+	 * Maps the C++ return type of a typed function to wasm results. void has no results, TTuple<...> has one per element.
+	 */
+	template <typename T>
+	struct TWasmTypedResults
+	{
+		typedef T Type;
+		static constexpr uint32 Num = 1;
+
+		static void GetKinds(wasm_valkind_t* OutKinds)
+		{
+			OutKinds[0] = TWasmValue<T>::Kind;
+		}
+
+		static void Read(const wasm_val_t* Values, Type& OutResult)
+		{
+			OutResult = static_cast<T>(TWasmValue<T>::GetValue(Values[0]));
+		}
+	};
+
+	template <>
+	struct TWasmTypedResults<void>
+	{
+		struct Type
+		{
+		};
+
+		static constexpr uint32 Num = 0;
+
+		static void GetKinds(wasm_valkind_t* OutKinds)
+		{
+		}
+
+		static void Read(const wasm_val_t* Values, Type& OutResult)
+		{
+		}
+	};
+
+	template <typename... ResultTypes>
+	struct TWasmTypedResults<TTuple<ResultTypes...>>
+	{
+		typedef TTuple<ResultTypes...> Type;
+		static constexpr uint32 Num = sizeof...(ResultTypes);
+
+		static void GetKinds(wasm_valkind_t* OutKinds)
+		{
+			uint32 Index = 0;
+			((OutKinds[Index++] = TWasmValue<ResultTypes>::Kind), ...);
+			(void)Index;
+		}
+
+		static void Read(const wasm_val_t* Values, Type& OutResult)
+		{
+			ReadElements(Values, OutResult, TMakeIntegerSequence<uint32, sizeof...(ResultTypes)>());
+		}
+
+	private:
+		template <uint32... Indices>
+		static void ReadElements(const wasm_val_t* Values, Type& OutResult, TIntegerSequence<uint32, Indices...>)
+		{
+			((OutResult.template Get<Indices>() = static_cast<ResultTypes>(TWasmValue<ResultTypes>::GetValue(Values[Indices]))), ...);
+		}
+	};
+
+	template <typename FunctionType>
+	class TWasmTypedFunc;
+
+	/**
+	 * Export bound to a C++ signature, e.g. TWasmTypedFunc<TTuple<int32, float>(int32, double)>.
+	 * The signature is checked once in Bind, calls keep arguments and results on the stack and never allocate.
+	 */
+	template <typename ReturnType, typename... ArgTypes>
+	class TWasmTypedFunc<ReturnType(ArgTypes...)>
+	{
+	public:
+		typedef TWasmTypedResults<ReturnType> TResults;
+		typedef typename TResults::Type TResultType;
+
+		static constexpr uint32 NumArgs = sizeof...(ArgTypes);
+		static constexpr uint32 NumResults = TResults::Num;
+
+		TWasmTypedFunc() = default;
+
+		TWasmTypedFunc(const TWasmExecutionContext& Context, const FName& InExportName)
+		{
+			Bind(Context, InExportName);
+		}
+
+		/**
+		 * Resolves the export on Context. Fails if it isn't a function or its signature doesn't match.
+		 * The handle is only valid while Context is alive.
+		 */
+		bool Bind(const TWasmExecutionContext& Context, const FName& InExportName)
+		{
+			Func = nullptr;
+			ExportName = InExportName;
+
+			wasm_extern_t* Extern = Context.FindExport(InExportName);
+			wasm_func_t* ExportFunc = Extern ? wasm_extern_as_func(Extern) : nullptr;
+			if (!ExportFunc)
+			{
+				UE_LOG(LogUEWasmTime, Warning, TEXT("Typed function (%s): no such exported function."), *InExportName.ToString());
+				return false;
+			}
+
+			// One extra element so empty signatures don't declare zero sized arrays.
+			const wasm_valkind_t ArgKinds[NumArgs + 1] = {TWasmValue<ArgTypes>::Kind...};
+			wasm_valkind_t ResultKinds[NumResults + 1] = {};
+			TResults::GetKinds(ResultKinds);
+			if (!WasmFuncTypeMatches(ExportFunc, ArgKinds, NumArgs, ResultKinds, NumResults))
+			{
+				UE_LOG(LogUEWasmTime, Error, TEXT("Typed function (%s): signature doesn't match the export."), *InExportName.ToString());
+				return false;
+			}
+
+			Func = ExportFunc;
+			return true;
+		}
+
+		FORCEINLINE bool IsBound() const
+		{
+			return Func != nullptr;
+		}
+
+		FORCEINLINE const FName& GetExportName() const
+		{
+			return ExportName;
+		}
+
+		bool Call(ArgTypes... Args, TResultType& OutResult, bool bPrintError = true) const
+		{
+			checkf(Func, TEXT("Typed function (%s) called without being bound."), *ExportName.ToString());
+
+			wasm_val_t ArgValues[NumArgs + 1];
+			wasm_val_t ResultValues[NumResults + 1];
+
+			uint32 ArgIndex = 0;
+			((ArgValues[ArgIndex++] = TWasmValue<ArgTypes>::NewValue(Args)), ...);
+			(void)ArgIndex;
+
+			const wasm_val_vec_t ArgsVec = wasm_val_vec_t{NumArgs, ArgValues};
+			wasm_val_vec_t ResultsVec = wasm_val_vec_t{NumResults, ResultValues};
+
+			const auto ErrorContext = [this]()
+			{
+				return FString::Printf(TEXT("Function Call (%s)"), *ExportName.ToString());
+			};
+			wasm_trap_t* Trap = nullptr;
+			wasmtime_error_t* CallError = wasmtime_func_call(Func, &ArgsVec, &ResultsVec, &Trap);
+			if (!HandleError(ErrorContext, CallError, Trap, bPrintError))
+			{
+				return false;
+			}
+
+			TResults::Read(ResultValues, OutResult);
+			return true;
+		}
+
+		/**
+		 * Calls the function and discards its results.
+		 */
+		FORCEINLINE bool Call(ArgTypes... Args) const
+		{
+			TResultType Ignored;
+			return Call(Args..., Ignored);
+		}
+
+	protected:
+		wasm_func_t* Func = nullptr;
+		FName ExportName;
+	};
+}
@@ -0,0 +1,83 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "UEWasmAPI.h"
+#include "WasmModuleAsset.generated.h"
+
+/**
+ * Wasm module compiled ahead of time. Holds the native artifact produced by wasmtime_module_serialize, so loading it at runtime
+ * only deserializes and never compiles. The source binary is editor only and stripped from cooked builds.
+ */
+UCLASS(BlueprintType)
+class UEWASMTIME_API UWasmModuleAsset : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Hash of the source binary and engine configuration the artifact was compiled from. */
+	UPROPERTY(VisibleAnywhere, Category = "Wasm")
+	FString ArtifactKey;
+
+	/** Engine configuration the artifact was compiled with, the runtime engine has to match it. */
+	UPROPERTY(VisibleAnywhere, Category = "Wasm")
+	FString EngineConfigKey;
+
+	UPROPERTY(VisibleAnywhere, Category = "Wasm")
+	FString WasmtimeVersion;
+
+	/** The artifact was compiled from a pre-initialized binary, its init export already ran and was removed. */
+	UPROPERTY(VisibleAnywhere, Category = "Wasm")
+	bool bPreInitialized = false;
+
+#if WITH_EDITORONLY_DATA
+	UPROPERTY(VisibleAnywhere, Category = "Wasm")
+	FString SourceFilePath;
+
+	/** If set, this export is run while precompiling and the resulting memory and globals are baked into the artifact. */
+	UPROPERTY(EditAnywhere, Category = "Wasm")
+	FString PreInitExport;
+#endif
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	/**
+	 * Deserializes the precompiled artifact. In the editor a missing or stale artifact falls back to compiling the source binary.
+	 * @param RuntimeEngineConfigKey ConfigKey of Engine's profile, the artifact is only used when it was compiled for it.
+	 */
+	UEWas::TWasmModule LoadModule(const UEWas::TWasmEngine& Engine, FString& OutErrorString, const FString& RuntimeEngineConfigKey) const;
+
+	FORCEINLINE bool HasCompiledArtifact() const
+	{
+		return CompiledArtifact.Num() > 0;
+	}
+
+	FORCEINLINE int32 GetCompiledArtifactSize() const
+	{
+		return CompiledArtifact.Num();
+	}
+
+#if WITH_EDITOR
+	void SetSourceBinary(TArray<uint8>&& InSourceBinary, const FString& InSourceFilePath);
+
+	/**
+	 * Validates the source binary and replaces the artifact with one compiled by Engine, pre-initialized if PreInitExport is set.
+	 */
+	bool Precompile(const UEWas::TWasmEngine& Engine, const FString& InEngineConfigKey, FString& OutErrorString);
+
+	UEWas::TWasmByteVec GetSourceBinary() const;
+
+	/**
+	 * Source binary with PreInitExport applied, what the artifact gets compiled from.
+	 */
+	UEWas::TWasmByteVec GetCompileBinary(const UEWas::TWasmEngine& Engine, FString& OutErrorString) const;
+#endif
+
+protected:
+	TArray<uint8> CompiledArtifact;
+
+#if WITH_EDITORONLY_DATA
+	TArray<uint8> SourceBinary;
+#endif
+};
@@ -28,6 +28,7 @@ public class UEWasmTime : ModuleRules
 			new string[]
 			{
 				"Core",
+				"CoreUObject",
 				"UEWasmTimeLibrary",
 				"Projects"
 				// ... add other public dependencies that you statically link with here ...
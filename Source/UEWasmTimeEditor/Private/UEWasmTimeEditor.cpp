@@ -0,0 +1,5 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "Modules/ModuleManager.h"
+
+IMPLEMENT_MODULE(FDefaultModuleImpl, UEWasmTimeEditor)
@@ -0,0 +1,158 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "WasmPrecompileCommandlet.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+#include "UEWasmEngineSettings.h"
+#include "UEWasmPreInit.h"
+#include "WasmModuleAsset.h"
+
+using namespace UEWas;
+
+UWasmPrecompileCommandlet::UWasmPrecompileCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UWasmPrecompileCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamVals;
+	ParseCommandLine(*Params, Tokens, Switches, ParamVals);
+
+	// Artifacts are only valid for the engine configuration the game runs with.
+	const FString* Profile = ParamVals.Find(TEXT("Profile"));
+	const FWasmEngineProfile& EngineProfile = GetSharedWasmEngineProfile(Profile ? FName(**Profile) : NAME_None);
+	const FString& EngineConfigKey = EngineProfile.ConfigKey;
+	const TWasmEngine& Engine = EngineProfile.Engine;
+
+	TArray<UWasmModuleAsset*> Assets;
+	if (const FString* Source = ParamVals.Find(TEXT("Source")))
+	{
+		const FString* Destination = ParamVals.Find(TEXT("Destination"));
+		const FString& DestinationPath = Destination ? *Destination : TEXT("/Game/Wasm");
+
+		TArray<FString> SourceFiles;
+		if (FPaths::DirectoryExists(*Source))
+		{
+			IFileManager::Get().FindFilesRecursive(SourceFiles, **Source, TEXT("*.wasm"), true, false);
+		}
+		else
+		{
+			SourceFiles.Add(*Source);
+		}
+
+		for (const FString& SourceFile : SourceFiles)
+		{
+			if (UWasmModuleAsset* Asset = ImportSource(SourceFile, DestinationPath))
+			{
+				Assets.Add(Asset);
+			}
+		}
+	}
+	else
+	{
+		IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+		AssetRegistry.SearchAllAssets(true);
+
+		TArray<FAssetData> AssetDataList;
+		AssetRegistry.GetAssetsByClass(UWasmModuleAsset::StaticClass()->GetClassPathName(), AssetDataList);
+		for (const FAssetData& AssetData : AssetDataList)
+		{
+			if (UWasmModuleAsset* Asset = Cast<UWasmModuleAsset>(AssetData.GetAsset()))
+			{
+				Assets.Add(Asset);
+			}
+		}
+	}
+
+	// -PreInit alone uses the default init export, -PreInit=<Export> names it. Assets keep it for later runs.
+	const FString* PreInitExport = ParamVals.Find(TEXT("PreInit"));
+	const bool bPreInit = PreInitExport || Switches.Contains(TEXT("PreInit"));
+
+	int32 NumFailed = 0;
+	for (UWasmModuleAsset* Asset : Assets)
+	{
+		if (bPreInit)
+		{
+			Asset->PreInitExport = PreInitExport ? *PreInitExport : TWasmPreInitOptions().InitExport;
+		}
+
+		if (!PrecompileAndSave(Asset, Engine, EngineConfigKey))
+		{
+			NumFailed++;
+		}
+	}
+
+	UE_LOG(LogUEWasmTime, Display, TEXT("Precompiled %i wasm modules, %i failed."), Assets.Num() - NumFailed, NumFailed);
+	return NumFailed == 0 ? 0 : 1;
+}
+
+UWasmModuleAsset* UWasmPrecompileCommandlet::ImportSource(const FString& SourceFile, const FString& DestinationPath) const
+{
+	TArray<uint8> Binary;
+	if (!FFileHelper::LoadFileToArray(Binary, *SourceFile))
+	{
+		UE_LOG(LogUEWasmTime, Error, TEXT("Failed to read wasm source %s"), *SourceFile);
+		return nullptr;
+	}
+
+	const FString& AssetName = MakeObjectNameFromDisplayLabel(FPaths::GetBaseFilename(SourceFile), NAME_None).ToString();
+	const FString& PackageName = FPaths::Combine(DestinationPath, AssetName);
+
+	UPackage* Package = nullptr;
+	if (FPackageName::DoesPackageExist(PackageName))
+	{
+		Package = LoadPackage(nullptr, *PackageName, LOAD_None);
+	}
+	if (!Package)
+	{
+		Package = CreatePackage(*PackageName);
+	}
+
+	UWasmModuleAsset* Asset = FindObject<UWasmModuleAsset>(Package, *AssetName);
+	if (!Asset)
+	{
+		Asset = NewObject<UWasmModuleAsset>(Package, *AssetName, RF_Public | RF_Standalone);
+		FAssetRegistryModule::AssetCreated(Asset);
+	}
+
+	Asset->SetSourceBinary(MoveTemp(Binary), FPaths::ConvertRelativePathToFull(SourceFile));
+	return Asset;
+}
+
+bool UWasmPrecompileCommandlet::PrecompileAndSave(UWasmModuleAsset* Asset, const TWasmEngine& Engine, const FString& EngineConfigKey) const
+{
+	check(Asset);
+
+	FString Error;
+	if (!Asset->Precompile(Engine, EngineConfigKey, Error))
+	{
+		UE_LOG(LogUEWasmTime, Error, TEXT("Failed to precompile %s: %s"), *Asset->GetPathName(), *Error);
+		return false;
+	}
+
+	UPackage* Package = Asset->GetOutermost();
+	const FString& FileName = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension());
+
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	SaveArgs.Error = GError;
+	if (!UPackage::SavePackage(Package, Asset, *FileName, SaveArgs))
+	{
+		UE_LOG(LogUEWasmTime, Error, TEXT("Failed to save %s"), *FileName);
+		return false;
+	}
+
+	UE_LOG(LogUEWasmTime, Display, TEXT("Precompiled %s (%i bytes%s)."), *Asset->GetPathName(), Asset->GetCompiledArtifactSize(),
+	       Asset->bPreInitialized ? TEXT(", pre-initialized") : TEXT(""));
+	return true;
+}
@@ -0,0 +1,33 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "UEWasmAPI.h"
+#include "WasmPrecompileCommandlet.generated.h"
+
+class UWasmModuleAsset;
+
+/**
+ * Validates and compiles wasm modules ahead of time into UWasmModuleAsset packages, so packaged builds only deserialize them.
+ *
+ * -Source=<file or directory> imports .wasm files into assets under -Destination (defaults to /Game/Wasm) and compiles them.
+ * Without -Source every UWasmModuleAsset in the project is recompiled, run it before cooking.
+ * -Profile=<Name> compiles with the [WasmTime.Engine.<Name>] engine settings instead of the default profile.
+ * -PreInit[=<Export>] runs the init export (wizer.initialize by default) while compiling and bakes the resulting memory and
+ * globals into the artifact, see WasmPreInitialize. Modules importing game host functions can't be pre-initialized here.
+ */
+UCLASS()
+class UWasmPrecompileCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UWasmPrecompileCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+	UWasmModuleAsset* ImportSource(const FString& SourceFile, const FString& DestinationPath) const;
+	bool PrecompileAndSave(UWasmModuleAsset* Asset, const UEWas::TWasmEngine& Engine, const FString& EngineConfigKey) const;
+};
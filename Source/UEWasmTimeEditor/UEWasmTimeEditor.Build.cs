@@ -0,0 +1,23 @@
+// Copyright SIA Chemical Heads 2022
+
+using UnrealBuildTool;
+
+public class UEWasmTimeEditor : ModuleRules
+{
+	public UEWasmTimeEditor(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"Engine",
+				"AssetRegistry",
+				"UEWasmTime",
+				"UEWasmTimeLibrary"
+			}
+			);
+	}
+}